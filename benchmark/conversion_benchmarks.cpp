@@ -0,0 +1,109 @@
+#include <arba/inis/inis.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+
+namespace
+{
+
+template <class ValueType>
+ValueType sample_value();
+
+template <>
+int sample_value<int>()
+{
+    return -123456;
+}
+
+template <>
+std::int64_t sample_value<std::int64_t>()
+{
+    return 9876543210;
+}
+
+template <>
+unsigned sample_value<unsigned>()
+{
+    return 4000000000u;
+}
+
+template <>
+float sample_value<float>()
+{
+    return 3.14159f;
+}
+
+template <>
+double sample_value<double>()
+{
+    return -2.718281828459045;
+}
+
+template <>
+bool sample_value<bool>()
+{
+    return true;
+}
+
+} // namespace
+
+template <class ValueType>
+static void BM_setting_value_to(benchmark::State& state)
+{
+    const inis::setting_value value(inis::value_to_setting_string(sample_value<ValueType>()));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(value.to<ValueType>());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_setting_value_to, int);
+BENCHMARK_TEMPLATE(BM_setting_value_to, std::int64_t);
+BENCHMARK_TEMPLATE(BM_setting_value_to, unsigned);
+BENCHMARK_TEMPLATE(BM_setting_value_to, float);
+BENCHMARK_TEMPLATE(BM_setting_value_to, double);
+BENCHMARK_TEMPLATE(BM_setting_value_to, bool);
+
+template <class ValueType>
+static void BM_value_to_setting_string(benchmark::State& state)
+{
+    const ValueType value = sample_value<ValueType>();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(inis::value_to_setting_string(value));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, int);
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, std::int64_t);
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, unsigned);
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, float);
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, double);
+BENCHMARK_TEMPLATE(BM_value_to_setting_string, bool);
+
+template <class ValueType>
+static void BM_cached_setting_value_to(benchmark::State& state)
+{
+    inis::section settings;
+    settings.enable_typed_value_cache();
+    settings.set_setting("value", sample_value<ValueType>());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.setting<ValueType>("value"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_cached_setting_value_to, int);
+BENCHMARK_TEMPLATE(BM_cached_setting_value_to, std::int64_t);
+BENCHMARK_TEMPLATE(BM_cached_setting_value_to, double);
+BENCHMARK_TEMPLATE(BM_cached_setting_value_to, bool);
+
+template <class ValueType>
+static void BM_uncached_setting_value_to(benchmark::State& state)
+{
+    inis::section settings;
+    settings.set_setting("value", sample_value<ValueType>());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.setting<ValueType>("value"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_uncached_setting_value_to, int);
+BENCHMARK_TEMPLATE(BM_uncached_setting_value_to, std::int64_t);
+BENCHMARK_TEMPLATE(BM_uncached_setting_value_to, double);
+BENCHMARK_TEMPLATE(BM_uncached_setting_value_to, bool);
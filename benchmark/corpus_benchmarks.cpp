@@ -0,0 +1,135 @@
+#include "inis_corpus.hpp"
+
+#include <arba/inis/inis.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+// Benchmarks on generated corpora from 1 KiB to 1 GiB (use --benchmark_filter to select the sizes).
+
+namespace
+{
+
+// The generated corpora, and their trees, are kept (one per size): the benchmarks run one after the other on all the
+// sizes, and share them. The largest corpus uses most of the memory anyway.
+struct corpus_cache
+{
+    inis_corpus::corpus corpus;
+    std::unique_ptr<inis::section> settings;
+};
+
+corpus_cache& cached_corpus(std::size_t size, bool with_settings)
+{
+    static std::map<std::size_t, corpus_cache> caches;
+    auto [iter, is_new] = caches.try_emplace(size);
+    corpus_cache& cache = iter->second;
+    if (is_new)
+        cache.corpus = inis_corpus::generate_corpus(inis_corpus::default_corpus_options(size));
+    if (with_settings && !cache.settings)
+    {
+        cache.settings = std::make_unique<inis::section>();
+        cache.settings->read_from_buffer(cache.corpus.text);
+    }
+    return cache;
+}
+
+// Counts the written characters, without storing them.
+class null_streambuf : public std::streambuf
+{
+protected:
+    int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+void corpus_sizes(benchmark::internal::Benchmark* benchmark)
+{
+    for (std::int64_t size = 1 << 10; size <= (std::int64_t(1) << 30); size *= 32)
+        benchmark->Arg(size);
+}
+
+} // namespace
+
+static void BM_corpus_read_from_stream(benchmark::State& state)
+{
+    const inis_corpus::corpus& corpus = cached_corpus(state.range(0), false).corpus;
+    for (auto _ : state)
+    {
+        std::istringstream stream(corpus.text);
+        inis::section settings;
+        settings.read_from_stream(stream);
+        benchmark::DoNotOptimize(settings);
+    }
+    state.SetBytesProcessed(state.iterations() * corpus.text.size());
+    state.counters["settings"] = static_cast<double>(corpus.number_of_settings);
+}
+BENCHMARK(BM_corpus_read_from_stream)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
+
+static void BM_corpus_setting_int(benchmark::State& state)
+{
+    corpus_cache& cache = cached_corpus(state.range(0), true);
+    const auto& paths = cache.corpus.integer_paths;
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cache.settings->setting<int>(paths[index]));
+        index = index + 1 < paths.size() ? index + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_corpus_setting_int)->Apply(corpus_sizes);
+
+static void BM_corpus_formatted_setting(benchmark::State& state)
+{
+    corpus_cache& cache = cached_corpus(state.range(0), true);
+    const auto& paths = cache.corpus.reference_paths;
+    if (paths.empty())
+    {
+        state.SkipWithError("The corpus has no reference.");
+        return;
+    }
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cache.settings->formatted_setting(paths[index]));
+        index = index + 1 < paths.size() ? index + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_corpus_formatted_setting)->Apply(corpus_sizes);
+
+static void BM_corpus_set_setting(benchmark::State& state)
+{
+    corpus_cache& cache = cached_corpus(state.range(0), true);
+    const auto& paths = cache.corpus.string_paths;
+    const std::string values[2] = { "first_value", "second_value" };
+    std::size_t index = 0;
+    std::size_t value_index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cache.settings->set_setting(paths[index], values[value_index]));
+        if (++index == paths.size())
+        {
+            index = 0;
+            value_index ^= 1;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_corpus_set_setting)->Apply(corpus_sizes);
+
+static void BM_corpus_write_to_stream(benchmark::State& state)
+{
+    corpus_cache& cache = cached_corpus(state.range(0), true);
+    null_streambuf buffer;
+    std::ostream stream(&buffer);
+    for (auto _ : state)
+        cache.settings->write_to_stream(stream);
+    state.SetBytesProcessed(state.iterations() * cache.corpus.text.size());
+}
+BENCHMARK(BM_corpus_write_to_stream)->Apply(corpus_sizes)->Unit(benchmark::kMillisecond);
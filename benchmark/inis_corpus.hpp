@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Deterministic generator of synthetic inis texts for the benchmarks.
+// The same options always give the same text, on every platform.
+namespace inis_corpus
+{
+
+struct corpus_options
+{
+    std::size_t target_size;          // the text is complete once it has at least this size (in bytes)
+    std::size_t section_depth;        // number of components of the section paths (at least 1)
+    std::size_t fan_out;              // subsections of each section, below the first level (which is not bounded)
+    std::size_t settings_per_section; // settings of each leaf section
+    std::size_t min_value_size;       // size of a string value, or of a line of a multi-line or split value
+    std::size_t max_value_size;
+    double multi_line_ratio; // ratio of '=|' values
+    double split_line_ratio; // ratio of '=>' values
+    double reference_ratio;  // ratio of values referencing another setting ('{...}')
+    std::uint64_t seed;
+};
+
+inline corpus_options default_corpus_options(std::size_t target_size)
+{
+    return corpus_options{ target_size, 3, 8, 8, 4, 32, 0.02, 0.02, 0.1, 0x5eed };
+}
+
+struct corpus
+{
+    std::string text;
+    std::size_t number_of_sections = 0;
+    std::size_t number_of_settings = 0;
+    // Samples of full setting paths (at most max_samples of each kind, spread over the whole text):
+    std::vector<std::string> integer_paths;
+    std::vector<std::string> string_paths;
+    std::vector<std::string> reference_paths;
+
+    inline constexpr static std::size_t max_samples = 4096;
+};
+
+// splitmix64: small, fast, and good enough to shape a corpus.
+class splitmix64
+{
+public:
+    explicit splitmix64(std::uint64_t seed) : state_(seed) {}
+
+    std::uint64_t operator()()
+    {
+        std::uint64_t value = (state_ += 0x9e3779b97f4a7c15ull);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+
+    // Uniform in [min, max].
+    std::size_t between(std::size_t min, std::size_t max) { return min + (*this)() % (max - min + 1); }
+    // Uniform in [0, 1).
+    double probability() { return static_cast<double>((*this)() >> 11) * 0x1.0p-53; }
+
+private:
+    std::uint64_t state_;
+};
+
+namespace detail
+{
+
+inline void append_word(std::string& text, splitmix64& random, std::size_t min_size, std::size_t max_size)
+{
+    const std::size_t size = random.between(min_size, max_size);
+    for (std::size_t index = 0; index < size; ++index)
+        text.push_back(static_cast<char>('a' + random() % 26));
+}
+
+// Keeps every n-th sample, n doubling each time the samples are full: the samples stay spread over the whole text.
+inline void add_sample(std::vector<std::string>& samples, std::size_t& stride, std::size_t& counter,
+                       std::string_view path)
+{
+    if (counter++ % stride != 0)
+        return;
+    if (samples.size() == corpus::max_samples)
+    {
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < samples.size(); index += 2)
+            samples[kept++] = std::move(samples[index]);
+        samples.resize(kept);
+        stride *= 2;
+    }
+    samples.emplace_back(path);
+}
+
+} // namespace detail
+
+// The leaf sections are 'g<i>.s<j>.s<k>...' (section_depth components), each one with settings_per_section settings:
+// references to key_0 of the section (relative '{...key_0}' or absolute path), multi-line and split values, then
+// integers (key_0 and a quarter of the remaining settings) and strings.
+inline corpus generate_corpus(const corpus_options& options)
+{
+    corpus result;
+    std::string& text = result.text;
+    text.reserve(options.target_size + 1024);
+    splitmix64 random(options.seed);
+    const std::size_t depth = options.section_depth ? options.section_depth : 1;
+    const std::size_t fan_out = options.fan_out ? options.fan_out : 1;
+    std::size_t leaves_per_group = 1;
+    for (std::size_t level = 1; level < depth; ++level)
+        leaves_per_group *= fan_out;
+
+    std::size_t strides[3] = { 1, 1, 1 };
+    std::size_t counters[3] = { 0, 0, 0 };
+    std::string key_0_path;
+    std::string section_path;
+    std::string setting_path;
+    for (std::size_t section_index = 0; text.size() < options.target_size; ++section_index)
+    {
+        section_path = "g" + std::to_string(section_index / leaves_per_group);
+        for (std::size_t rest = section_index % leaves_per_group, divisor = leaves_per_group / fan_out; divisor;
+             divisor /= fan_out)
+        {
+            section_path += ".s" + std::to_string(rest / divisor);
+            rest %= divisor;
+        }
+        text.append("[").append(section_path).append("]\n");
+        ++result.number_of_sections;
+
+        for (std::size_t setting_index = 0; setting_index < options.settings_per_section; ++setting_index)
+        {
+            const std::string name = "key_" + std::to_string(setting_index);
+            setting_path.assign(section_path).append(".").append(name);
+            text.append(name);
+            // key_0 is an integer, which the next settings of the section can reference.
+            const double kind = setting_index == 0 ? 1.0 : random.probability();
+            const double multi_line_threshold = options.reference_ratio + options.multi_line_ratio;
+            const double split_line_threshold = multi_line_threshold + options.split_line_ratio;
+            if (kind < options.reference_ratio)
+            {
+                text.append(" = ");
+                if (random() % 2)
+                    text.append("{").append(depth, '.').append("key_0}_");
+                else
+                    text.append("{").append(key_0_path).append("}_");
+                detail::append_word(text, random, options.min_value_size, options.max_value_size);
+                text.append("\n");
+                detail::add_sample(result.reference_paths, strides[2], counters[2], setting_path);
+            }
+            else if (kind < split_line_threshold)
+            {
+                text.append(kind < multi_line_threshold ? " =|END\n" : " =>\n");
+                for (std::size_t line = random.between(2, 4); line > 0; --line)
+                {
+                    detail::append_word(text, random, options.min_value_size, options.max_value_size);
+                    text.append("\n");
+                }
+                text.append(kind < multi_line_threshold ? "END\n" : "\n");
+            }
+            else if (setting_index == 0 || random() % 4 == 0)
+            {
+                text.append(" = ").append(std::to_string(random() % 1000000)).append("\n");
+                detail::add_sample(result.integer_paths, strides[0], counters[0], setting_path);
+                if (setting_index == 0)
+                    key_0_path = setting_path;
+            }
+            else
+            {
+                text.append(" = ");
+                detail::append_word(text, random, options.min_value_size, options.max_value_size);
+                text.append("\n");
+                detail::add_sample(result.string_paths, strides[1], counters[1], setting_path);
+            }
+            ++result.number_of_settings;
+        }
+        text.append("\n");
+    }
+    return result;
+}
+
+} // namespace inis_corpus
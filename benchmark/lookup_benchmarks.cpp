@@ -0,0 +1,162 @@
+#include <arba/inis/config_handle.hpp>
+#include <arba/inis/frozen_config.hpp>
+#include <arba/inis/inis.hpp>
+#include <arba/inis/layered_config.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+inis::section make_settings()
+{
+    std::istringstream stream(R"inis(
+rsc = resource
+[root.branch.leaf]
+key = value
+number = 42
+key_2 = {...key}_2
+key_2_3 = {...key_2}_3
+path = {rsc}/{.key_2_3}/file.txt
+)inis");
+    inis::section settings;
+    settings.read_from_stream(stream);
+    return settings;
+}
+
+inis::section make_large_settings(std::size_t number_of_sections, std::vector<std::string>& setting_paths)
+{
+    inis::section settings;
+    for (std::size_t i = 0; i < number_of_sections; ++i)
+    {
+        const std::string section_path = "root.branch_" + std::to_string(i % 16) + ".leaf_" + std::to_string(i);
+        settings.create_sections(section_path);
+        for (std::size_t j = 0; j < 8; ++j)
+        {
+            setting_paths.push_back(section_path + ".key_" + std::to_string(j));
+            settings.set_setting(setting_paths.back(), static_cast<int>(j));
+        }
+    }
+    // Visit the settings in an order unrelated to the tree layout:
+    for (std::size_t i = 0; i < setting_paths.size(); ++i)
+        std::swap(setting_paths[i], setting_paths[(i * 7919) % setting_paths.size()]);
+    return settings;
+}
+
+} // namespace
+
+static void BM_setting_by_path(benchmark::State& state)
+{
+    inis::section settings = make_settings();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.setting<std::string_view>("root.branch.leaf.key"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_setting_by_path);
+
+static void BM_setting_by_compiled_path(benchmark::State& state)
+{
+    inis::section settings = make_settings();
+    const inis::compiled_path path = settings.compile_path("root.branch.leaf.key");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.setting<std::string_view>(path));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_setting_by_compiled_path);
+
+static void BM_formatted_setting(benchmark::State& state)
+{
+    inis::section settings = make_settings();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.formatted_setting("root.branch.leaf.path"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_formatted_setting);
+
+static void BM_frozen_setting_by_path(benchmark::State& state)
+{
+    const inis::frozen_config config(make_settings());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(config.setting<std::string_view>("root.branch.leaf.key"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_frozen_setting_by_path);
+
+static void BM_setting_in_large_tree(benchmark::State& state)
+{
+    std::vector<std::string> setting_paths;
+    const inis::section settings = make_large_settings(state.range(0), setting_paths);
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(settings.setting<int>(setting_paths[index]));
+        if (++index == setting_paths.size())
+            index = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_setting_in_large_tree)->Arg(64)->Arg(16384);
+
+static void BM_frozen_setting_in_large_tree(benchmark::State& state)
+{
+    std::vector<std::string> setting_paths;
+    const inis::frozen_config config(make_large_settings(state.range(0), setting_paths));
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(config.setting<int>(setting_paths[index]));
+        if (++index == setting_paths.size())
+            index = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["memory_size"] = config.memory_size();
+}
+BENCHMARK(BM_frozen_setting_in_large_tree)->Arg(64)->Arg(16384);
+
+static void BM_mutex_protected_setting(benchmark::State& state)
+{
+    static std::mutex mutex;
+    static const inis::section settings = make_settings();
+    for (auto _ : state)
+    {
+        std::lock_guard lock(mutex);
+        benchmark::DoNotOptimize(settings.setting<int>("root.branch.leaf.number"));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mutex_protected_setting)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_config_handle_reader_setting(benchmark::State& state)
+{
+    static inis::config_handle handle(make_settings());
+    inis::config_handle::reader reader = handle.make_reader();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(reader->setting<int>("root.branch.leaf.number"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_config_handle_reader_setting)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_config_handle_snapshot_setting(benchmark::State& state)
+{
+    static inis::config_handle handle(make_settings());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(handle.snapshot()->setting<int>("root.branch.leaf.number"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_config_handle_snapshot_setting)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_layered_setting(benchmark::State& state)
+{
+    inis::layered_config config;
+    for (std::int64_t i = 0; i < state.range(0); ++i)
+        config.push_layer(make_settings());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(config.setting<int>("root.branch.leaf.number"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_layered_setting)->Arg(1)->Arg(8);
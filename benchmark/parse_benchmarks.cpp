@@ -0,0 +1,211 @@
+#include <arba/inis/frozen_config.hpp>
+#include <arba/inis/inis.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::string make_inis_text(std::size_t number_of_sections, std::size_t settings_per_section)
+{
+    std::string text;
+    for (std::size_t i = 0; i < number_of_sections; ++i)
+    {
+        text += "[root.branch_" + std::to_string(i % 16) + ".leaf_" + std::to_string(i) + "]\n";
+        for (std::size_t j = 0; j < settings_per_section; ++j)
+            text += "key_" + std::to_string(j) + " = value_" + std::to_string(j) + " // comment\n";
+        text += '\n';
+    }
+    return text;
+}
+
+std::size_t count_lines(const std::string& text)
+{
+    return std::count(text.begin(), text.end(), '\n');
+}
+
+} // namespace
+
+static void BM_read_from_stream(benchmark::State& state)
+{
+    const std::string text = make_inis_text(state.range(0), state.range(1));
+    for (auto _ : state)
+    {
+        std::istringstream stream(text);
+        inis::section settings;
+        settings.read_from_stream(stream);
+        benchmark::DoNotOptimize(settings);
+    }
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_read_from_stream)->Args({ 64, 4 })->Args({ 1024, 4 })->Args({ 1024, 32 });
+
+static void BM_read_from_file(benchmark::State& state)
+{
+    const std::string text = make_inis_text(state.range(0), state.range(1));
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_parse_benchmarks.inis";
+    std::ofstream(path) << text;
+    for (auto _ : state)
+    {
+        inis::section settings;
+        settings.read_from_file(path);
+        benchmark::DoNotOptimize(settings);
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_read_from_file)->Args({ 16, 4 })->Args({ 1024, 32 });
+
+static void BM_read_from_buffer(benchmark::State& state)
+{
+    const std::string text = make_inis_text(state.range(0), state.range(1));
+    for (auto _ : state)
+    {
+        inis::section settings;
+        settings.read_from_buffer(text);
+        benchmark::DoNotOptimize(settings);
+    }
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_read_from_buffer)->Args({ 64, 4 })->Args({ 1024, 32 });
+
+static void BM_read_from_buffer_monotonic_resource(benchmark::State& state)
+{
+    const std::string text = make_inis_text(state.range(0), state.range(1));
+    for (auto _ : state)
+    {
+        std::pmr::monotonic_buffer_resource arena(text.size() * 2);
+        inis::section settings(&arena);
+        settings.read_from_buffer(text);
+        benchmark::DoNotOptimize(settings);
+    }
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_read_from_buffer_monotonic_resource)->Args({ 64, 4 })->Args({ 1024, 32 });
+
+static void BM_reload_from_buffer(benchmark::State& state)
+{
+    std::string text = make_inis_text(state.range(0), state.range(1));
+    inis::section settings;
+    settings.read_from_buffer(text);
+    // One value changes at each reload:
+    const std::size_t value_index = text.rfind("value_0");
+    for (auto _ : state)
+    {
+        text[value_index + 6] = text[value_index + 6] == '0' ? '1' : '0';
+        benchmark::DoNotOptimize(settings.reload_from_buffer(text));
+    }
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_reload_from_buffer)->Args({ 64, 4 })->Args({ 1024, 32 });
+
+static void BM_read_binary(benchmark::State& state)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_parse_benchmarks.binis";
+    {
+        inis::section settings;
+        settings.read_from_buffer(make_inis_text(state.range(0), state.range(1)));
+        inis::frozen_config(settings).write_binary(path);
+    }
+    for (auto _ : state)
+    {
+        inis::frozen_config config = inis::frozen_config::read_binary(path, state.range(2));
+        benchmark::DoNotOptimize(config);
+    }
+    state.SetBytesProcessed(state.iterations() * std::filesystem::file_size(path));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_read_binary)->Args({ 16, 4, true })->Args({ 1024, 32, true })->Args({ 1024, 32, false });
+
+static void BM_read_headers_only(benchmark::State& state)
+{
+    const std::string text = make_inis_text(state.range(0), 0);
+    for (auto _ : state)
+    {
+        std::istringstream stream(text);
+        inis::section settings;
+        settings.read_from_stream(stream);
+        benchmark::DoNotOptimize(settings);
+    }
+    state.SetItemsProcessed(state.iterations() * count_lines(text));
+}
+BENCHMARK(BM_read_headers_only)->Arg(4096);
+
+static void BM_create_sections(benchmark::State& state)
+{
+    inis::section settings;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.create_sections("root.branch.leaf"));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_create_sections);
+
+static void BM_set_setting(benchmark::State& state)
+{
+    inis::section settings;
+    settings.create_sections("root.branch.leaf");
+    const std::string path = "root.branch.leaf.key";
+    const std::string value = "value";
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.set_setting(path, value));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_set_setting);
+
+static void BM_set_setting_with_subscriptions(benchmark::State& state)
+{
+    inis::section settings;
+    settings.create_sections("root.branch.leaf");
+    std::size_t number_of_calls = 0;
+    settings.subscribe("root.branch", [&](const std::vector<std::string>&) { ++number_of_calls; });
+    for (std::int64_t i = 0; i < state.range(0); ++i)
+        settings.subscribe("root.other_" + std::to_string(i), [&](const std::vector<std::string>&) {});
+    const std::string path = "root.branch.leaf.key";
+    int value = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(settings.set_setting(path, ++value));
+    state.SetItemsProcessed(state.iterations());
+    state.counters["calls"] = static_cast<double>(number_of_calls);
+}
+BENCHMARK(BM_set_setting_with_subscriptions)->Arg(1)->Arg(10000);
+
+static void BM_read_from_directory(benchmark::State& state)
+{
+    // state.range(0) files of 16 sections of 8 settings, read by state.range(1) threads.
+    const std::size_t number_of_files = state.range(0);
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_directory_benchmarks";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string text = make_inis_text(16, 8);
+    for (std::size_t i = 0; i < number_of_files; ++i)
+        std::ofstream(dir / ("file_" + std::to_string(i) + ".inis")) << text;
+
+    const inis::section::directory_options options{ ".inis", static_cast<unsigned>(state.range(1)) };
+    for (auto _ : state)
+    {
+        inis::section settings;
+        settings.read_from_directory(dir, options);
+        benchmark::DoNotOptimize(settings);
+    }
+    std::filesystem::remove_all(dir);
+    state.SetItemsProcessed(state.iterations() * number_of_files * count_lines(text));
+    state.SetBytesProcessed(state.iterations() * number_of_files * text.size());
+}
+BENCHMARK(BM_read_from_directory)
+    ->ArgsProduct({ { 4096 }, benchmark::CreateRange(1, std::max(std::thread::hardware_concurrency(), 8u), 2) })
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,74 @@
+#include <arba/inis/line_scanner.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace
+{
+
+const std::string& large_inis_text()
+{
+    static const std::string text = []
+    {
+        std::string res;
+        for (std::size_t i = 0; res.size() < (std::size_t(64) << 20); ++i)
+        {
+            if (i % 32 == 0)
+                res += "[root.branch.leaf_" + std::to_string(i) + "]\n";
+            res += "some_setting_key_" + std::to_string(i) + " = some setting value " + std::to_string(i);
+            res += (i % 4 == 0) ? " // comment\n" : "\n";
+        }
+        return res;
+    }();
+    return text;
+}
+
+} // namespace
+
+static void BM_line_scanner(benchmark::State& state)
+{
+    const inis::scan_kernel kernel = static_cast<inis::scan_kernel>(state.range(0));
+    if (!inis::line_scanner::is_supported(kernel))
+    {
+        state.SkipWithError("Kernel not supported by this CPU.");
+        return;
+    }
+    const std::string& text = large_inis_text();
+    for (auto _ : state)
+    {
+        std::size_t equal_count = 0;
+        inis::line_scanner scanner(text, "//", kernel);
+        for (inis::line_delimiters delimiters; scanner.next(delimiters);)
+            equal_count += delimiters.equal != inis::line_delimiters::npos && delimiters.equal < delimiters.comment;
+        benchmark::DoNotOptimize(equal_count);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_line_scanner)
+    ->ArgName("kernel")
+    ->Arg(static_cast<int>(inis::scan_kernel::scalar))
+    ->Arg(static_cast<int>(inis::scan_kernel::sse2))
+    ->Arg(static_cast<int>(inis::scan_kernel::avx2));
+
+static void BM_naive_line_scan(benchmark::State& state)
+{
+    const std::string& text = large_inis_text();
+    for (auto _ : state)
+    {
+        std::size_t equal_count = 0;
+        std::string_view buffer = text;
+        for (std::size_t line_end = 0; line_end != std::string_view::npos;)
+        {
+            line_end = buffer.find('\n');
+            std::string_view line = buffer.substr(0, line_end);
+            std::size_t equal = line.find('=');
+            std::size_t comment = line.find("//");
+            equal_count += equal != std::string_view::npos && equal < comment;
+            buffer.remove_prefix(line_end == std::string_view::npos ? buffer.size() : line_end + 1);
+        }
+        benchmark::DoNotOptimize(equal_count);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_naive_line_scan);
@@ -0,0 +1,221 @@
+#include "inis_corpus.hpp"
+
+#include <arba/inis/document.hpp>
+#include <arba/inis/inis.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+// The serializer before the output buffer: operator<< per fragment, std::endl after each section header.
+void legacy_write_to_stream(const inis::section& sec, std::ostream& stream, const inis::section* root,
+                            std::string_view default_value_end_marker)
+{
+    if (&sec != root)
+    {
+        stream << '[';
+        if (sec.parent() != root)
+            stream << '.';
+        stream << sec.name() << ']' << std::endl;
+    }
+    for (const auto& entry : sec.settings())
+    {
+        if (entry.first.front() == '$')
+            continue;
+        stream << entry.first;
+        if (entry.second.find_first_of('\n') == std::string::npos)
+            stream << " = " << entry.second << '\n';
+        else
+            stream << " =| " << default_value_end_marker << "\n"
+                   << entry.second << "\n"
+                   << default_value_end_marker << "\n";
+    }
+    if (!sec.settings().empty())
+        stream << '\n';
+    for (const auto& entry : sec.sections())
+        legacy_write_to_stream(*entry.second, stream, root, default_value_end_marker);
+}
+
+const inis::section& corpus_settings(std::size_t size, std::size_t& text_size)
+{
+    static std::size_t cached_size = 0;
+    static std::size_t cached_text_size = 0;
+    static inis::section settings;
+    if (cached_size != size)
+    {
+        const inis_corpus::corpus corpus = inis_corpus::generate_corpus(inis_corpus::default_corpus_options(size));
+        settings = inis::section();
+        settings.read_from_buffer(corpus.text);
+        cached_size = size;
+        cached_text_size = corpus.text.size();
+    }
+    text_size = cached_text_size;
+    return settings;
+}
+
+void write_sizes(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->Arg(64 << 10)->Arg(4 << 20)->Arg(64 << 20)->Unit(benchmark::kMillisecond);
+}
+
+// Counts the written characters, without storing them: only the serializer is measured.
+class null_streambuf : public std::streambuf
+{
+protected:
+    int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    int sync() override { return 0; }
+};
+
+} // namespace
+
+static void BM_legacy_write_to_stream(benchmark::State& state)
+{
+    std::size_t text_size = 0;
+    const inis::section& settings = corpus_settings(state.range(0), text_size);
+    null_streambuf buffer;
+    std::ostream stream(&buffer);
+    for (auto _ : state)
+    {
+        legacy_write_to_stream(settings, stream, &settings, "");
+        stream.flush();
+    }
+    state.SetBytesProcessed(state.iterations() * text_size);
+}
+BENCHMARK(BM_legacy_write_to_stream)->Apply(write_sizes);
+
+static void BM_write_to_stream(benchmark::State& state)
+{
+    std::size_t text_size = 0;
+    inis::section& settings = const_cast<inis::section&>(corpus_settings(state.range(0), text_size));
+    null_streambuf buffer;
+    std::ostream stream(&buffer);
+    for (auto _ : state)
+        settings.write_to_stream(stream);
+    state.SetBytesProcessed(state.iterations() * text_size);
+}
+BENCHMARK(BM_write_to_stream)->Apply(write_sizes);
+
+static void BM_legacy_write_to_file(benchmark::State& state)
+{
+    std::size_t text_size = 0;
+    const inis::section& settings = corpus_settings(state.range(0), text_size);
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_write_benchmarks.inis";
+    for (auto _ : state)
+    {
+        std::ofstream stream(path);
+        legacy_write_to_stream(settings, stream, &settings, "");
+    }
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * text_size);
+}
+BENCHMARK(BM_legacy_write_to_file)->Apply(write_sizes);
+
+static void BM_write_to_file(benchmark::State& state)
+{
+    std::size_t text_size = 0;
+    inis::section& settings = const_cast<inis::section&>(corpus_settings(state.range(0), text_size));
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_write_benchmarks.inis";
+    for (auto _ : state)
+        settings.write_to_file(path, "");
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * text_size);
+}
+BENCHMARK(BM_write_to_file)->Apply(write_sizes);
+
+static void BM_write_to_file_atomic(benchmark::State& state)
+{
+    std::size_t text_size = 0;
+    inis::section& settings = const_cast<inis::section&>(corpus_settings(state.range(0), text_size));
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_write_benchmarks.inis";
+    for (auto _ : state)
+        settings.write_to_file(path, "", inis::section::write_mode::atomic);
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * text_size);
+}
+BENCHMARK(BM_write_to_file_atomic)->Apply(write_sizes);
+
+// One integer value is modified before each write: patch mode writes it in place (values of the same length), or
+// rewrites the end of the file from it (values of different lengths).
+static void BM_write_to_file_patch(benchmark::State& state)
+{
+    const inis_corpus::corpus corpus =
+        inis_corpus::generate_corpus(inis_corpus::default_corpus_options(state.range(0)));
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_patch_benchmarks.inis";
+    {
+        std::ofstream stream(path);
+        stream << corpus.text;
+    }
+    inis::section settings;
+    settings.enable_source_spans();
+    settings.read_from_file(path);
+    const bool same_length = state.range(1);
+    const std::string values[2] = { "1000001", same_length ? "1000002" : "10000002" };
+    for (const std::string& integer_path : corpus.integer_paths)
+        settings.set_setting(integer_path, values[0]);
+    settings.write_to_file(path, "", inis::section::write_mode::patch);
+    std::size_t index = 0;
+    std::size_t value_index = 1;
+    for (auto _ : state)
+    {
+        settings.set_setting(corpus.integer_paths[index], values[value_index]);
+        settings.write_to_file(path, "", inis::section::write_mode::patch);
+        if (++index == corpus.integer_paths.size())
+        {
+            index = 0;
+            value_index ^= 1;
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_write_to_file_patch)
+    ->ArgsProduct({ { 64 << 10, 4 << 20, 64 << 20 }, { 1, 0 } })
+    ->ArgNames({ "size", "same_length" })
+    ->Unit(benchmark::kMillisecond);
+
+// Edit of one setting of a text: the section tree is parsed and serialized entirely (the comments are lost), the
+// document parses the section of the setting, and copies the rest of the text.
+static void BM_edit_section_tree(benchmark::State& state)
+{
+    const inis_corpus::corpus corpus =
+        inis_corpus::generate_corpus(inis_corpus::default_corpus_options(state.range(0)));
+    null_streambuf buffer;
+    std::ostream stream(&buffer);
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        inis::section settings;
+        settings.read_from_buffer(corpus.text);
+        settings.set_setting(corpus.integer_paths[index], std::string("1000001"));
+        settings.write_to_stream(stream);
+        index = (index + 1) % corpus.integer_paths.size();
+    }
+    state.SetBytesProcessed(state.iterations() * corpus.text.size());
+}
+BENCHMARK(BM_edit_section_tree)->Apply(write_sizes);
+
+static void BM_edit_document(benchmark::State& state)
+{
+    const inis_corpus::corpus corpus =
+        inis_corpus::generate_corpus(inis_corpus::default_corpus_options(state.range(0)));
+    null_streambuf buffer;
+    std::ostream stream(&buffer);
+    std::size_t index = 0;
+    for (auto _ : state)
+    {
+        inis::document doc;
+        doc.read_from_buffer(corpus.text);
+        doc.set_setting(corpus.integer_paths[index], std::string("1000001"));
+        doc.write_to_stream(stream);
+        index = (index + 1) % corpus.integer_paths.size();
+    }
+    state.SetBytesProcessed(state.iterations() * corpus.text.size());
+}
+BENCHMARK(BM_edit_document)->Apply(write_sizes);
@@ -0,0 +1,41 @@
+#include <arba/inis/frozen_config.hpp>
+#include <arba/inis/inis.hpp>
+
+#include <filesystem>
+#include <iostream>
+
+// Usage: compile_inis [input.inis output.binis]
+// Compile an inis file into a binary image which can be loaded with inis::frozen_config::read_binary().
+int main(int argc, char** argv)
+{
+    std::filesystem::path input_path;
+    std::filesystem::path output_path;
+    if (argc == 3)
+    {
+        input_path = argv[1];
+        output_path = argv[2];
+    }
+    else
+    {
+        input_path = std::filesystem::temp_directory_path() / "compile_inis_example.inis";
+        output_path = std::filesystem::temp_directory_path() / "compile_inis_example.binis";
+        inis::section settings;
+        settings.set_setting("rsc", "resources");
+        settings.create_sections("section")->set_setting("path", "{rsc}/image.png");
+        settings.write_to_file(input_path, "");
+    }
+
+    inis::section settings;
+    settings.read_from_file(input_path);
+    inis::frozen_config(settings, inis::frozen_config::Formatted_values).write_binary(output_path);
+
+    inis::frozen_config config = inis::frozen_config::read_binary(output_path);
+    std::cout << output_path.generic_string() << ": " << config.number_of_sections() << " sections, "
+              << config.number_of_settings() << " settings, " << config.binary_image().size() << " bytes"
+              << std::endl;
+    if (argc != 3)
+        std::cout << config.setting<std::string>("section.path") << std::endl;
+
+    std::cout << "EXIT SUCCESS" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <arba/inis/inis.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Publishes immutable section trees to concurrent readers (read-copy-update).
+// A published tree is never modified: a new version is built aside (read_from_file(), publish()), then swapped in
+// atomically. A reader holds a snapshot of one version, which stays valid even if a new version is published.
+// Lookups on a published tree (setting(), formatted_setting(), format()) are thread-safe and never modify it: its
+// typed value cache is disabled, and its values with references are formatted when it is published (from its root).
+// A compiled_path must still be used by one thread only.
+class config_handle
+{
+public:
+    using snapshot_ptr = std::shared_ptr<const section>;
+
+    // Reader used by one thread. It keeps the last snapshot it read, and loads the published one only when the version
+    // changed: in the common case, current() is one atomic load and does not touch the snapshot reference count.
+    class reader
+    {
+    public:
+        explicit reader(const config_handle& handle);
+
+        inline const section& current()
+        {
+            const std::uint64_t version = handle_->version();
+            if (version != version_) [[unlikely]]
+            {
+                snapshot_ = handle_->snapshot();
+                version_ = version;
+            }
+            return *snapshot_;
+        }
+        inline const section* operator->() { return &current(); }
+        inline std::uint64_t version() const { return version_; }
+        inline const snapshot_ptr& snapshot() const { return snapshot_; }
+
+    private:
+        const config_handle* handle_;
+        // The version is loaded before the snapshot: the snapshot is never older than the version.
+        std::uint64_t version_;
+        snapshot_ptr snapshot_;
+    };
+
+    config_handle();
+    explicit config_handle(section&& tree);
+    config_handle(const config_handle&) = delete;
+    config_handle& operator=(const config_handle&) = delete;
+
+    inline snapshot_ptr snapshot() const { return snapshot_.load(std::memory_order_acquire); }
+    inline std::uint64_t version() const { return version_.load(std::memory_order_acquire); }
+    inline reader make_reader() const { return reader(*this); }
+
+    // Publishes a new version. The tree must be a root section.
+    void publish(section&& tree);
+    // Reads a new version from a file and publishes it. If reading fails, the current version stays published.
+    void read_from_file(const std::filesystem::path& path);
+
+private:
+    std::atomic<snapshot_ptr> snapshot_;
+    std::atomic<std::uint64_t> version_;
+};
+
+} // namespace inis
+} // namespace arba
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <arba/inis/inis.hpp>
+#include <arba/inis/mapped_file.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Lossless view of an inis text: the text is kept as it is (comments, blank lines, layout, order), with the span of
+// each of its lines and the blocks of each section (a block being the lines of a section header). A section is parsed
+// in the tree the first time it is accessed, and the writes copy the text, except the lines of the settings which were
+// modified, added or removed. Loading a large file to modify a few settings thus costs the indexing of its lines, the
+// parsing of the modified sections, and the copy of the text.
+// Settings added to a section of the text are written after its last setting, and new sections at the end of the
+// text. If the text includes files ('@include'), all its sections are parsed when it is read, and the settings of the
+// included files are not written back.
+// Paths are full paths from the root ("section.subsection.setting").
+class document
+{
+public:
+    document() = default;
+    document(document&&) = default;
+    document& operator=(document&&) = default;
+
+    // read (the previous content is discarded):
+    // The file is mapped, and its settings directory ($settings_dir) is the directory of the file.
+    void read_from_file(const std::filesystem::path& path);
+    // The buffer is copied. Like section::read_from_buffer(), the settings directory of the previous content is kept:
+    // it is the base of the relative include directives of the buffer.
+    void read_from_buffer(std::string_view buffer);
+
+    inline std::string_view text() const { return text_; }
+    inline std::size_t number_of_lines() const { return lines_.size(); }
+    inline std::size_t number_of_indexed_sections() const { return sections_.size(); }
+    bool is_parsed(std::string_view section_path) const;
+
+    // sections (they are parsed when they are accessed):
+    // Returns the section, with all its subsections, or nullptr if it is neither in the text nor in the tree.
+    section* section_ptr(std::string_view section_path);
+    // Parses all the sections, and returns the complete tree.
+    section& tree();
+
+    // settings:
+    template <class ValueType>
+        requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
+    ValueType setting(std::string_view setting_path, const ValueType& default_value = ValueType())
+    {
+        const setting_value* value = find_setting_(setting_path);
+        return value ? value->to<ValueType>(default_value) : default_value;
+    }
+
+    template <class ValueType>
+        requires(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>)
+    ValueType setting(std::string_view setting_path, std::string_view default_value = std::string_view())
+    {
+        const setting_value* value = find_setting_(setting_path);
+        return value && !value->is_default() ? ValueType(*value) : ValueType(default_value);
+    }
+
+    // Modifies or adds the setting (its sections are created if needed).
+    bool set_setting(std::string_view setting_path, const std::string& value);
+
+    template <class ValueType>
+        requires(!std::is_same_v<ValueType, std::string>)
+    bool set_setting(std::string_view setting_path, const ValueType& value)
+    {
+        return set_setting(setting_path, value_to_setting_string(value));
+    }
+
+    // write:
+    // The multi-line values which were modified or added are written with the end marker (the default one of
+    // section::write_to_stream(): an empty line).
+    void write_to_stream(std::ostream& stream, std::string_view default_value_end_marker = "") const;
+    // The file is replaced atomically (see atomic_file_writer): it can be the file of the document.
+    void write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker = "") const;
+
+private:
+    // Span of a line in the text, without its '\n'.
+    struct line_span
+    {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    // Lines of a setting of the text, and span of its value in the text if it is a single-line value.
+    struct setting_source
+    {
+        std::string_view name; // in the text
+        std::size_t first_line;
+        std::size_t last_line;
+        std::size_t value_offset;
+        std::size_t value_length;
+        bool is_single_line;
+        std::string original_value; // multi-line and split values only
+    };
+
+    struct section_entry
+    {
+        std::vector<std::size_t> blocks; // indexes in blocks_
+        std::vector<setting_source> settings;
+        bool is_parsed = false;
+    };
+
+    struct block
+    {
+        std::size_t header_line; // npos for the block of the root (the lines before the first header)
+        std::size_t first_line;
+        std::size_t end_line;
+    };
+
+    using section_dictionary = std::unordered_map<std::string, section_entry, string_hash, std::equal_to<>>;
+
+    // A piece of the written text replacing the range [begin, end) of the text.
+    struct text_edit
+    {
+        std::size_t begin;
+        std::size_t end;
+        std::string text;
+    };
+
+    // The text stays at the same address when the document is moved: the index refers to it.
+    struct text_storage
+    {
+        mapped_file file;
+        std::string buffer;
+    };
+
+    inline constexpr static std::size_t npos = static_cast<std::size_t>(-1);
+    inline constexpr static std::string_view comment_marker_ = "//";
+
+    void read_text_(std::unique_ptr<text_storage> storage, std::string_view text,
+                    const std::filesystem::path& settings_dir);
+    // Returns true if the text has include directives.
+    bool index_lines_();
+    section_dictionary::iterator add_section_entry_(std::string_view section_path);
+    section* parse_section_(section_dictionary::value_type& entry);
+    // Returns the section, without parsing its subsections (see section_ptr()).
+    section* local_section_ptr_(std::string_view section_path);
+    const setting_value* find_setting_(std::string_view setting_path);
+    void collect_external_paths_(const section& sec, std::string& path);
+    void collect_edits_(std::vector<text_edit>& edits, std::string& appended_text,
+                        std::string_view default_value_end_marker) const;
+    void collect_new_sections_(const section& sec, std::string& path, std::string& appended_text,
+                               std::string_view default_value_end_marker) const;
+    template <class Sink>
+    void write_(Sink&& write_chunk, std::string_view default_value_end_marker) const;
+    static void append_setting_(std::string& output, std::string_view name, std::string_view value,
+                                std::string_view default_value_end_marker);
+    inline std::size_t line_end_(std::size_t line_index) const
+    {
+        return lines_[line_index].offset + lines_[line_index].length;
+    }
+
+private:
+    std::unique_ptr<text_storage> storage_;
+    std::string_view text_;
+    std::vector<line_span> lines_;
+    std::vector<block> blocks_;
+    section_dictionary sections_;
+    std::vector<const section_dictionary::value_type*> section_order_; // order of first declaration
+    // Full paths of the settings of the included files, which are not written back:
+    std::unordered_set<std::string, string_hash, std::equal_to<>> external_paths_;
+    section tree_;
+};
+
+} // namespace inis
+} // namespace arba
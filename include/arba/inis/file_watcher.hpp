@@ -0,0 +1,117 @@
+#pragma once
+
+#include <arba/inis/config_handle.hpp>
+#include <arba/inis/inis.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Watches inis files and reloads them when they are modified.
+// Modifications are detected with inotify on Linux (the directory of each file is watched, so that files replaced by
+// a rename are detected), otherwise by polling the modification time and the size of the files. The files included by
+// a watched file are watched too (once the file is read): their modification reloads the file. A burst of events on a
+// file is debounced: the file is reloaded once no event was received for the debounce delay. Only the modified files
+// are read again. When the settings of a file changed, the new tree and the paths of the changed settings are
+// delivered to the callbacks, on the background thread of the watcher. If a file cannot be read, its previous tree is
+// kept and a warning is written on std::cerr.
+class file_watcher
+{
+public:
+    using snapshot_ptr = std::shared_ptr<const section>;
+
+    struct change_event
+    {
+        std::filesystem::path path;
+        snapshot_ptr tree;
+        std::vector<std::string> changed_setting_paths;
+    };
+
+    using callback = std::function<void(const change_event&)>;
+
+    enum class backend
+    {
+        automatic,
+        inotify,
+        polling,
+    };
+
+    explicit file_watcher(std::chrono::milliseconds debounce_delay = std::chrono::milliseconds(50),
+                          backend watch_backend = backend::automatic,
+                          std::chrono::milliseconds poll_interval = std::chrono::milliseconds(500));
+    file_watcher(const file_watcher&) = delete;
+    file_watcher& operator=(const file_watcher&) = delete;
+    ~file_watcher();
+
+    // Reads the file and watches it. Throws if the file cannot be read.
+    snapshot_ptr watch(const std::filesystem::path& path);
+    // Reads the file, publishes it in the handle, and publishes each new version of the file in the handle.
+    // The handle must outlive the watch.
+    void watch(const std::filesystem::path& path, config_handle& handle);
+    // Waits for a reload of the file in progress: the handle of the file can be destroyed once it returns.
+    void unwatch(const std::filesystem::path& path);
+    snapshot_ptr tree(const std::filesystem::path& path) const;
+
+    // Returns an identifier to remove the callback.
+    std::size_t add_callback(callback function);
+    void remove_callback(std::size_t callback_id);
+
+    inline backend active_backend() const { return backend_; }
+    static bool is_supported(backend watch_backend);
+
+private:
+    struct watched_source;
+    struct watched_file;
+
+    void watch_(const std::filesystem::path& path, config_handle* handle);
+    // Reads the file in the tree, and returns the paths of the files it includes (even if it cannot be read).
+    static std::vector<std::filesystem::path> read_file_(const std::filesystem::path& path, section& tree,
+                                                         std::exception_ptr& error);
+    std::vector<watched_source> make_sources_(const std::vector<std::filesystem::path>& paths) const;
+    // The mutex must be locked:
+    void update_included_sources_(watched_file& file, std::vector<watched_source> included_sources);
+    int add_watch_(const std::filesystem::path& path);
+    void release_watches_(watched_file& file);
+    void wake_();
+    void run_();
+    void wait_for_events_(std::chrono::steady_clock::time_point deadline);
+    void read_inotify_events_();
+    void poll_files_();
+    void reload_(watched_file& file);
+    void stop_();
+
+private:
+    std::chrono::milliseconds debounce_delay_;
+    std::chrono::milliseconds poll_interval_;
+    backend backend_;
+    // Held while a reload publishes a tree, before mutex_ when both are locked.
+    std::mutex reload_mutex_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<std::shared_ptr<watched_file>> files_;
+    std::unordered_map<int, std::size_t> watch_references_; // number of watched sources per inotify watch descriptor
+    std::vector<std::pair<std::size_t, callback>> callbacks_;
+    std::size_t next_callback_id_ = 0;
+    bool stopped_ = false;
+    bool woken_ = false;
+    int inotify_fd_ = -1;
+    int wake_fds_[2] = { -1, -1 };
+    std::thread thread_;
+};
+
+} // namespace inis
+} // namespace arba
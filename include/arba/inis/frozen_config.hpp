@@ -0,0 +1,188 @@
+#pragma once
+
+#include <arba/inis/inis.hpp>
+#include <arba/inis/mapped_file.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Immutable and compact snapshot of a section tree, for configurations which are only read after loading.
+// All the names and values are stored in one string pool, the sections and the settings in two contiguous arrays:
+// the subsections (and the settings) of a section are a range of their array, sorted by name length then by name,
+// and are found by binary search. Setting paths are dotted paths relative to the section which is read
+// ("section.subsection.setting").
+// Values are stored as they are in the section tree, or formatted if requested when the tree is frozen.
+//
+// The snapshot is one relocatable image (offsets, no pointers) which can be saved with write_binary() and loaded with
+// read_binary(): the loaded image is served as is, without parsing. The image is versioned and checksummed. It uses
+// the byte order of the machine which wrote it, and is rejected by a machine with another byte order.
+class frozen_config
+{
+    struct image_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order_mark;
+        std::uint32_t number_of_sections;
+        std::uint32_t number_of_settings;
+        std::uint32_t string_pool_size;
+        std::uint32_t reserved;
+        std::uint64_t checksum; // FNV-1a of the image after the header
+    };
+
+    struct string_ref
+    {
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    struct section_node
+    {
+        string_ref name;
+        std::uint32_t parent = 0;
+        std::uint32_t first_section = 0;
+        std::uint32_t number_of_sections = 0;
+        std::uint32_t first_setting = 0;
+        std::uint32_t number_of_settings = 0;
+    };
+
+    struct setting_node
+    {
+        string_ref name;
+        string_ref value;
+    };
+
+public:
+    class section_view
+    {
+    public:
+        inline std::string_view name() const { return config_->string_(node_().name); }
+        inline bool is_root() const { return index_ == 0; }
+        inline std::size_t number_of_sections() const { return node_().number_of_sections; }
+        inline std::size_t number_of_settings() const { return node_().number_of_settings; }
+
+        bool has_subsection(std::string_view section_path) const;
+        section_view subsection(std::string_view section_path) const;
+        bool has_setting(std::string_view setting_path) const;
+
+        template <class ValueType>
+            requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
+        ValueType setting(std::string_view setting_path, const ValueType& default_value = ValueType()) const
+        {
+            const setting_node* node = find_setting_(setting_path);
+            if (node && node->value.length > 0)
+            {
+                ValueType value;
+                if (setting_string_to_value(config_->string_(node->value), value))
+                    return value;
+            }
+            return default_value;
+        }
+
+        template <class ValueType>
+            requires(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>)
+        ValueType setting(std::string_view setting_path, std::string_view default_value = std::string_view()) const
+        {
+            const setting_node* node = find_setting_(setting_path);
+            if (node && node->value.length > 0)
+                return ValueType(config_->string_(node->value));
+            return ValueType(default_value);
+        }
+
+    private:
+        friend class frozen_config;
+
+        section_view(const frozen_config* config, std::uint32_t index) : config_(config), index_(index) {}
+
+        inline const section_node& node_() const { return config_->sections_[index_]; }
+        const section_node* find_section_(std::string_view section_path) const;
+        const setting_node* find_setting_(std::string_view setting_path) const;
+
+    private:
+        const frozen_config* config_;
+        std::uint32_t index_;
+    };
+
+    enum value_mode : uint8_t
+    {
+        Raw_values,
+        Formatted_values,
+    };
+
+    inline constexpr static std::uint32_t binary_version = 1;
+
+    frozen_config();
+    explicit frozen_config(const section& root, value_mode mode = Raw_values);
+    frozen_config(frozen_config&& other) noexcept;
+    frozen_config& operator=(frozen_config&& other) noexcept;
+    frozen_config(const frozen_config&) = delete;
+    frozen_config& operator=(const frozen_config&) = delete;
+
+    // binary image:
+    void write_binary(std::ostream& stream) const;
+    // The file is replaced, not truncated (see atomic_file_writer, without sync).
+    void write_binary(const std::filesystem::path& path) const;
+    // Load an image written by write_binary(). The file is memory-mapped when it is big enough (see mapped_file).
+    // Throw std::runtime_error if the image is invalid: the ranges of its nodes are always checked, and its content
+    // only if verify_checksum is true.
+    static frozen_config read_binary(const std::filesystem::path& path, bool verify_checksum = true);
+    inline std::string_view binary_image() const { return image_; }
+
+    inline section_view root() const { return section_view(this, 0); }
+
+    inline bool has_subsection(std::string_view section_path) const { return root().has_subsection(section_path); }
+    inline section_view subsection(std::string_view section_path) const { return root().subsection(section_path); }
+    inline bool has_setting(std::string_view setting_path) const { return root().has_setting(setting_path); }
+
+    template <class ValueType>
+        requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
+    ValueType setting(std::string_view setting_path, const ValueType& default_value = ValueType()) const
+    {
+        return root().setting<ValueType>(setting_path, default_value);
+    }
+
+    template <class ValueType>
+        requires(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>)
+    ValueType setting(std::string_view setting_path, std::string_view default_value = std::string_view()) const
+    {
+        return root().setting<ValueType>(setting_path, default_value);
+    }
+
+    inline std::size_t number_of_sections() const { return header_().number_of_sections; }
+    inline std::size_t number_of_settings() const { return header_().number_of_settings; }
+    // Number of bytes used by the snapshot.
+    inline std::size_t memory_size() const { return sizeof(*this) + image_.size(); }
+
+private:
+    frozen_config(mapped_file image_file, bool verify_checksum);
+
+    inline const image_header& header_() const { return *reinterpret_cast<const image_header*>(image_.data()); }
+    inline std::string_view string_(const string_ref& ref) const
+    {
+        return std::string_view(string_pool_ + ref.offset, ref.length);
+    }
+    void set_image_(std::string_view image);
+    // Throws std::runtime_error if a node refers to data out of the image.
+    void validate_nodes_() const;
+
+private:
+    // Image layout: header, section nodes, setting nodes, string pool.
+    std::string image_buffer_;
+    mapped_file image_file_;
+    std::string_view image_;
+    const section_node* sections_ = nullptr;
+    const setting_node* settings_ = nullptr;
+    const char* string_pool_ = nullptr;
+};
+
+} // namespace inis
+} // namespace arba
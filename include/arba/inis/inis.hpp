@@ -1,29 +1,96 @@
 #pragma once
 
+#include <arba/inis/line_scanner.hpp>
+
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <cstdlib>
 #include <filesystem>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 inline namespace arba
 {
 namespace inis
 {
 
+// Arithmetic types converted with std::from_chars/std::to_chars (character types and bool excepted).
+template <typename ValueType>
+concept charconv_setting_value_type =
+    (std::is_integral_v<ValueType>
+#if defined(__cpp_lib_to_chars)
+     || std::is_floating_point_v<ValueType>
+#endif
+     )
+    && !std::is_same_v<ValueType, bool> && !std::is_same_v<ValueType, char> && !std::is_same_v<ValueType, signed char>
+    && !std::is_same_v<ValueType, unsigned char> && !std::is_same_v<ValueType, wchar_t>
+    && !std::is_same_v<ValueType, char8_t> && !std::is_same_v<ValueType, char16_t>
+    && !std::is_same_v<ValueType, char32_t>;
+
 template <typename ValueType>
-bool setting_string_to_value(const std::string& setting_value, ValueType& value)
+bool setting_string_to_value(std::string_view setting_value, ValueType& value)
 {
-    std::istringstream stream(setting_value);
+    std::istringstream stream{ std::string(setting_value) };
     if (stream >> value)
         return stream.eof();
     return false;
 }
 
+template <charconv_setting_value_type ValueType>
+bool setting_string_to_value(std::string_view setting_value, ValueType& value)
+{
+    // Like a stream, leading spaces and a '+' sign are accepted.
+    const char* first = setting_value.data();
+    const char* last = first + setting_value.size();
+    while (first != last && (*first == ' ' || (*first >= '\t' && *first <= '\r')))
+        ++first;
+    if (first != last && *first == '+' && std::next(first) != last && *std::next(first) != '-')
+        ++first;
+    ValueType res;
+    auto [ptr, error] = std::from_chars(first, last, res);
+    if (error != std::errc() || ptr != last || first == last)
+        return false;
+    value = res;
+    return true;
+}
+
+// Accepts (case insensitive): true/false, yes/no, on/off, 1/0.
+inline bool setting_string_to_value(std::string_view setting_value, bool& value)
+{
+    auto equals = [](std::string_view str, std::string_view lower_case_str)
+    {
+        return str.length() == lower_case_str.length()
+               && std::equal(str.begin(), str.end(), lower_case_str.begin(),
+                             [](char ch, char lower_ch) { return (ch | 0x20) == lower_ch; });
+    };
+    if (setting_value == "1" || equals(setting_value, "true") || equals(setting_value, "yes")
+        || equals(setting_value, "on"))
+    {
+        value = true;
+        return true;
+    }
+    if (setting_value == "0" || equals(setting_value, "false") || equals(setting_value, "no")
+        || equals(setting_value, "off"))
+    {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
 template <typename ValueType>
 std::string value_to_setting_string(const ValueType& value)
 {
@@ -32,13 +99,197 @@ std::string value_to_setting_string(const ValueType& value)
     return stream.str();
 }
 
+template <charconv_setting_value_type ValueType>
+std::string value_to_setting_string(const ValueType& value)
+{
+    char buffer[64];
+    auto [ptr, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, ptr);
+}
+
+inline std::string value_to_setting_string(const bool& value)
+{
+    return value ? std::string("true") : std::string("false");
+}
+
+// The value of a setting.
+// It can cache its last successful conversion to an integral type (stored as int64), to double or to bool, so that
+// repeated typed reads of the same value do not parse it again. The cache is disabled by default and is enabled per
+// tree (see section::enable_typed_value_cache()). Its slot is allocated out of line when it is enabled (16 bytes per
+// setting): a value without cache only costs a null pointer (40 bytes instead of 32 with libstdc++). The modifiers of
+// std::string are hidden by members which clear the cache, like the assignments, and so are the members giving a
+// mutable access to the characters. A modification through a std::string reference to the base class does not clear
+// the cache. When enabled, to() writes the cache: concurrent reads of the same value are then not thread-safe.
 class setting_value : public std::string
 {
 public:
     using std::string::string;
 
+    setting_value() = default;
+    setting_value(std::string_view str) : std::string(str) {}
     setting_value(const std::string& str) : std::string(str) {}
     setting_value(std::string&& str) : std::string(std::move(str)) {}
+    // A copy has an empty cache if the cache of the copied value is enabled.
+    setting_value(const setting_value& other) : std::string(other) { enable_cache_(other.cache_ != nullptr); }
+    setting_value(setting_value&&) noexcept = default;
+
+    setting_value& operator=(const setting_value& other)
+    {
+        std::string::operator=(other);
+        clear_cache_();
+        return *this;
+    }
+
+    setting_value& operator=(setting_value&& other) noexcept
+    {
+        std::string::operator=(std::move(other));
+        clear_cache_();
+        return *this;
+    }
+
+    template <class StringType>
+        requires std::is_assignable_v<std::string&, StringType&&>
+    setting_value& operator=(StringType&& str)
+    {
+        std::string::operator=(std::forward<StringType>(str));
+        clear_cache_();
+        return *this;
+    }
+
+    inline const std::string& str() const noexcept { return *this; }
+
+    // modification (the cache is cleared):
+    template <class... Args>
+    inline setting_value& assign(Args&&... args)
+    {
+        std::string::assign(std::forward<Args>(args)...);
+        clear_cache_();
+        return *this;
+    }
+
+    template <class... Args>
+    inline setting_value& append(Args&&... args)
+    {
+        std::string::append(std::forward<Args>(args)...);
+        clear_cache_();
+        return *this;
+    }
+
+    template <class Arg>
+    inline setting_value& operator+=(Arg&& arg)
+    {
+        std::string::operator+=(std::forward<Arg>(arg));
+        clear_cache_();
+        return *this;
+    }
+
+    template <class... Args>
+    inline decltype(auto) insert(Args&&... args)
+    {
+        clear_cache_();
+        return std::string::insert(std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    inline decltype(auto) erase(Args&&... args)
+    {
+        clear_cache_();
+        return std::string::erase(std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    inline decltype(auto) replace(Args&&... args)
+    {
+        clear_cache_();
+        return std::string::replace(std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    inline void resize(Args&&... args)
+    {
+        std::string::resize(std::forward<Args>(args)...);
+        clear_cache_();
+    }
+
+    inline void push_back(char ch)
+    {
+        std::string::push_back(ch);
+        clear_cache_();
+    }
+
+    inline void pop_back()
+    {
+        std::string::pop_back();
+        clear_cache_();
+    }
+
+    inline void clear() noexcept
+    {
+        std::string::clear();
+        clear_cache_();
+    }
+
+    inline void swap(std::string& other) noexcept
+    {
+        std::string::swap(other);
+        clear_cache_();
+    }
+
+    // mutable access (the cache is cleared, the characters can be modified through the result):
+    inline reference operator[](size_type index)
+    {
+        clear_cache_();
+        return std::string::operator[](index);
+    }
+    inline const_reference operator[](size_type index) const { return std::string::operator[](index); }
+    inline reference at(size_type index)
+    {
+        clear_cache_();
+        return std::string::at(index);
+    }
+    inline const_reference at(size_type index) const { return std::string::at(index); }
+    inline reference front()
+    {
+        clear_cache_();
+        return std::string::front();
+    }
+    inline const_reference front() const { return std::string::front(); }
+    inline reference back()
+    {
+        clear_cache_();
+        return std::string::back();
+    }
+    inline const_reference back() const { return std::string::back(); }
+    inline pointer data() noexcept
+    {
+        clear_cache_();
+        return std::string::data();
+    }
+    inline const_pointer data() const noexcept { return std::string::data(); }
+    inline iterator begin() noexcept
+    {
+        clear_cache_();
+        return std::string::begin();
+    }
+    inline const_iterator begin() const noexcept { return std::string::begin(); }
+    inline iterator end() noexcept
+    {
+        clear_cache_();
+        return std::string::end();
+    }
+    inline const_iterator end() const noexcept { return std::string::end(); }
+    inline reverse_iterator rbegin() noexcept
+    {
+        clear_cache_();
+        return std::string::rbegin();
+    }
+    inline const_reverse_iterator rbegin() const noexcept { return std::string::rbegin(); }
+    inline reverse_iterator rend() noexcept
+    {
+        clear_cache_();
+        return std::string::rend();
+    }
+    inline const_reverse_iterator rend() const noexcept { return std::string::rend(); }
 
     bool is_default() const { return empty(); }
 
@@ -47,17 +298,175 @@ public:
     {
         if (!is_default())
         {
+            if constexpr (is_cachable_type_<ValueType>)
+            {
+                if (cache_)
+                    return cached_to_(default_value);
+            }
             ValueType res;
-            if (setting_string_to_value(*this, res))
+            if (setting_string_to_value(std::string_view(*this), res))
                 return res;
         }
         return default_value;
     }
+
+    inline bool is_typed_value_cache_enabled() const { return cache_ != nullptr; }
+
+private:
+    friend class section;
+
+    enum cache_tag : uint8_t
+    {
+        Empty_cache,
+        Int64_cache,
+        Double_cache,
+        Bool_cache,
+    };
+
+    struct typed_cache
+    {
+        union
+        {
+            std::int64_t int64_value;
+            double double_value;
+            bool bool_value;
+        } value{ 0 };
+        cache_tag tag = Empty_cache;
+    };
+
+    template <class ValueType>
+    inline constexpr static bool is_cachable_type_ =
+        (charconv_setting_value_type<ValueType> && std::is_integral_v<ValueType>) || std::is_same_v<ValueType, double>
+        || std::is_same_v<ValueType, bool>;
+
+    template <class ValueType>
+    ValueType cached_to_(const ValueType& default_value) const
+    {
+        typed_cache& cache = *cache_;
+        if constexpr (std::is_same_v<ValueType, bool>)
+        {
+            if (cache.tag == Bool_cache)
+                return cache.value.bool_value;
+        }
+        else if constexpr (std::is_same_v<ValueType, double>)
+        {
+            if (cache.tag == Double_cache)
+                return cache.value.double_value;
+        }
+        else if (cache.tag == Int64_cache)
+        {
+            // The text is a valid int64: it is a valid ValueType only if the integer is in the ValueType range.
+            if (std::in_range<ValueType>(cache.value.int64_value))
+                return static_cast<ValueType>(cache.value.int64_value);
+            return default_value;
+        }
+
+        ValueType res;
+        if (!setting_string_to_value(std::string_view(*this), res))
+            return default_value;
+        if constexpr (std::is_same_v<ValueType, bool>)
+        {
+            cache.value.bool_value = res;
+            cache.tag = Bool_cache;
+        }
+        else if constexpr (std::is_same_v<ValueType, double>)
+        {
+            cache.value.double_value = res;
+            cache.tag = Double_cache;
+        }
+        else if (std::in_range<std::int64_t>(res))
+        {
+            cache.value.int64_value = static_cast<std::int64_t>(res);
+            cache.tag = Int64_cache;
+        }
+        return res;
+    }
+
+    inline void enable_cache_(bool enable)
+    {
+        if (!enable)
+            cache_.reset();
+        else if (!cache_)
+            cache_ = std::make_unique<typed_cache>();
+    }
+
+    inline void clear_cache_() noexcept
+    {
+        if (cache_)
+            cache_->tag = Empty_cache;
+    }
+
+private:
+    mutable std::unique_ptr<typed_cache> cache_;
 };
 
+class section;
+
+// Setting path compiled by section::compile_path() for repeated lookups.
+// It caches the resolved setting, which is resolved again only if the structure of the tree changed (a section or a
+// setting was added or removed). A compiled_path must not be used by several threads at the same time.
+class compiled_path
+{
+public:
+    compiled_path() = default;
+
+    inline const std::string& path() const { return path_; }
+
+private:
+    friend class section;
+
+    compiled_path(const section* base, std::string path) : path_(std::move(path)), base_(base) {}
+
+private:
+    std::string path_;
+    const section* base_ = nullptr;
+    mutable const setting_value* value_ = nullptr;
+    mutable std::uint64_t generation_ = std::numeric_limits<std::uint64_t>::max();
+};
+
+// Hash of std::string keys usable with std::string_view (heterogeneous lookup).
+struct string_hash
+{
+    using is_transparent = void;
+
+    inline std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>{}(str); }
+};
+
+class config_handle;
+class document;
+class frozen_config;
+class layered_config;
+
 class section
 {
+    friend class config_handle;
+    friend class document;
+    friend class file_watcher;
+    friend class frozen_config;
+    friend class layered_config;
+
     inline constexpr static std::string_view::value_type standard_label_mark_ = '$';
+    // Character classes of the inis grammar:
+    enum char_class : uint8_t
+    {
+        Label_char = 1, // [._[:alnum:]]
+        Space_char = 2, // [:space:]
+    };
+    inline constexpr static std::array<uint8_t, 256> char_class_table_ = []
+    {
+        std::array<uint8_t, 256> table{};
+        for (unsigned char ch = '0'; ch <= '9'; ++ch)
+            table[ch] = Label_char;
+        for (unsigned char ch = 'a'; ch <= 'z'; ++ch)
+            table[ch] = Label_char;
+        for (unsigned char ch = 'A'; ch <= 'Z'; ++ch)
+            table[ch] = Label_char;
+        table[static_cast<unsigned char>('.')] = Label_char;
+        table[static_cast<unsigned char>('_')] = Label_char;
+        for (unsigned char ch : { ' ', '\t', '\n', '\v', '\f', '\r' })
+            table[ch] = Space_char;
+        return table;
+    }();
 
     friend class parser;
     class parser
@@ -73,21 +482,63 @@ class section
 
     public:
         explicit parser(section* section);
+        ~parser();
         inline const section* sec() const { return this_section_; }
         inline section* sec() { return this_section_; }
         inline const std::string_view& comment_marker() const { return comment_marker_; }
         void parse(std::istream& stream);
         void parse(const std::filesystem::path& setting_filepath);
+        void parse(std::string_view buffer);
+        // Canonical paths of the files loaded for the include directives by the last parse, even if it failed.
+        std::vector<std::string> included_paths() const;
+
+        // Reading of a document (see document): the lines are read one block at a time, a block being the lines of a
+        // section header (without the header).
+        struct declared_setting
+        {
+            std::string_view name;    // in the line
+            std::string_view value;   // in the line (empty for a multi-line or split value)
+            setting_value* value_ptr; // nullptr if the line does not declare a new setting
+        };
+        void begin_document();
+        void begin_block(section* sec);
+        declared_setting read_block_line(std::string_view line);
+        inline bool is_reading_value() const { return current_value_ != nullptr; }
+        // Returns true if the line is a section header, and then its path (which may be relative: '.' prefixed).
+        static bool extract_header_path(const line_delimiters& delimiters, std::string_view& section_path);
+        static bool has_include_directive(const line_delimiters& delimiters);
 
     private:
+        struct included_file;
+        struct included_files;
+
+        inline constexpr static std::string_view include_directive = "@include";
+        // Maximum number of threads loading the included files.
+        inline constexpr static unsigned max_include_loading_threads = 16;
+
         void read_from_stream_(std::istream& stream);
-        bool try_create_setting_(const std::string_view& line);
+        void read_from_buffer_(std::string_view buffer);
+        void begin_read_();
+        void end_read_();
+        void read_line_(std::string_view line);
+        void read_line_(const line_delimiters& delimiters);
+        bool try_include_(const std::string_view& line);
+        void read_included_file_(const std::string& path);
+        void preload_included_files_(std::string_view buffer);
+        void load_included_files_(std::vector<std::string> paths);
+        std::filesystem::path include_base_dir_() const;
+        static std::unique_ptr<included_file> load_included_file_(const std::string& path,
+                                                                  std::string_view comment_marker);
+        static bool extract_include_path_(std::string_view line, std::string_view& include_path);
+        static std::string resolve_include_path_(const std::filesystem::path& base_dir, std::string_view include_path);
+        bool try_create_setting_(const std::string_view& line, std::size_t equal_index);
         bool try_create_sections_(const std::string_view& line);
+        static bool extract_section_path_(const std::string_view& line, std::string_view& section_path);
         void append_line_to_current_value_(const std::string_view& line);
         void reset_current_value_status_();
-        static bool extract_name_and_value_(std::string_view str, std::string_view& label, std::string_view& value,
-                                            std::string_view& value_end_marker, value_category& value_cat);
-        void remove_comment_(std::string_view& str);
+        static bool extract_name_and_value_(std::string_view str, std::size_t equal_index, std::string_view& label,
+                                            std::string_view& value, std::string_view& value_end_marker,
+                                            value_category& value_cat);
         static void remove_spaces_(std::string_view& str);
         static void remove_left_spaces_(std::string_view& str);
         static void remove_right_spaces_(std::string_view& str);
@@ -98,20 +549,56 @@ class section
         // current status:
         section* current_section_;
         setting_value* current_value_;
+        bool typed_value_cache_enabled_;
         value_category current_value_category_;
         std::string current_value_end_marker_;
+        // included files (canonical paths):
+        std::vector<std::string> include_stack_;
+        std::unique_ptr<included_files> included_files_;
+        std::vector<std::string> included_paths_; // of the last parse, once included_files_ is released
+        // positions of the values in the read file (see section::enable_source_spans()):
+        bool recording_source_spans_ = false;
+        const char* source_begin_ = nullptr;
+        // setting declared by the last line (see read_block_line()):
+        declared_setting declared_setting_{};
+    };
+
+    // Deletes a subsection allocated with the memory resource of its tree. The deleter of a tree read by
+    // read_from_directory() owns the arena of the tree, which is released after the tree.
+    struct subsection_deleter
+    {
+        std::pmr::memory_resource* resource;
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena = nullptr;
+
+        void operator()(section* sec) const noexcept;
     };
 
 public:
-    using settings_dictionnary = std::unordered_map<std::string, setting_value>;
+    using settings_dictionnary =
+        std::pmr::unordered_map<std::pmr::string, setting_value, string_hash, std::equal_to<>>;
+    using sections_dictionnary =
+        std::pmr::unordered_map<std::pmr::string, std::unique_ptr<section, subsection_deleter>, string_hash,
+                                std::equal_to<>>;
+    // Entries of the dictionaries in declaration order (the order in which they were read or added):
+    using ordered_settings = std::pmr::vector<const settings_dictionnary::value_type*>;
+    using ordered_sections = std::pmr::vector<const sections_dictionnary::value_type*>;
 
     inline constexpr static std::string_view settings_dir = "$settings_dir";
     inline constexpr static std::string_view working_dir = "$working_dir";
     inline constexpr static std::string_view tmp_dir = "$tmp_dir";
 
     // constructors:
+    // The nodes of the tree (subsections, dictionary nodes and setting names) are allocated with the memory resource
+    // given to the root section, which must outlive the tree. With a std::pmr::monotonic_buffer_resource, loading a
+    // file does a few large allocations and the deallocations of the tree are no-ops. Setting values are std::string
+    // and still use the global heap when they do not fit in the small string buffer.
     section();
     explicit section(std::string name);
+    explicit section(std::pmr::memory_resource* resource);
+    section(std::string name, std::pmr::memory_resource* resource);
+    section(section&& other) noexcept;
+    section& operator=(section&& other) noexcept;
+    ~section();
 
     // parent/root:
     inline section* parent() { return parent_; }
@@ -120,18 +607,30 @@ public:
     const section& root() const;
     inline bool is_root() const { return parent_ == nullptr; }
 
+    // memory resource of the tree:
+    inline std::pmr::memory_resource* resource() const { return settings_.get_allocator().resource(); }
+
     // name accessors:
     const std::string& name() const { return name_; }
     std::string& name() { return name_; }
 
     // settings accessors:
     inline const settings_dictionnary& settings() const { return settings_; }
+    inline const sections_dictionnary& sections() const { return sections_; }
+    // The settings and the subsections in declaration order, which is the order of write_to_stream(). A reload keeps
+    // the order of the new text.
+    inline const ordered_settings& settings_in_order() const { return setting_order_; }
+    inline const ordered_sections& sections_in_order() const { return section_order_; }
+
+    // typed value cache (see setting_value):
+    void enable_typed_value_cache(bool enable = true);
+    inline bool is_typed_value_cache_enabled() const { return root().typed_value_cache_enabled_; }
 
     template <class ValueType>
         requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
     ValueType setting(const std::string_view& setting_path, const ValueType& default_value = ValueType()) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value)
             return s_value->to<ValueType>(default_value);
         return default_value;
@@ -142,7 +641,7 @@ public:
                  && (std::is_same_v<DefaultValueType, std::string_view> || std::is_array_v<DefaultValueType>)
     std::string setting(const std::string_view& setting_path, const DefaultValueType& default_value) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value && !s_value->is_default())
             return *s_value;
         return std::string(default_value);
@@ -152,7 +651,7 @@ public:
         requires std::is_same_v<std::string, ValueType>
     const std::string& setting(const std::string_view& setting_path, const std::string& default_value) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value && !s_value->is_default())
             return *s_value;
         return default_value;
@@ -162,7 +661,7 @@ public:
         requires std::is_same_v<std::string, ValueType>
     std::string setting(const std::string_view& setting_path, std::string&& default_value) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value && !s_value->is_default())
             return *s_value;
         return std::string(default_value);
@@ -172,7 +671,7 @@ public:
         requires std::is_same_v<std::string, ValueType>
     std::string setting(const std::string_view& setting_path) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value)
             return *s_value;
         return std::string();
@@ -183,24 +682,78 @@ public:
     std::string_view setting(const std::string_view& setting_path,
                              const std::string_view& default_value = std::string_view()) const
     {
-        const setting_value* s_value = get_setting_value_ptr_(std::string(setting_path));
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
+        if (s_value && !s_value->is_default())
+            return *s_value;
+        return default_value;
+    }
+
+    // compiled path accessors:
+    compiled_path compile_path(const std::string_view& setting_path) const;
+    // Changes each time a section or a setting is added to or removed from the tree (see compiled_path).
+    inline std::uint64_t structure_generation() const { return root().structure_generation_; }
+
+    template <class ValueType>
+        requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
+    ValueType setting(const compiled_path& setting_path, const ValueType& default_value = ValueType()) const
+    {
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
+        if (s_value)
+            return s_value->to<ValueType>(default_value);
+        return default_value;
+    }
+
+    template <class ValueType>
+        requires std::is_same_v<std::string, ValueType>
+    const std::string& setting(const compiled_path& setting_path, const std::string& default_value) const
+    {
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
+        if (s_value && !s_value->is_default())
+            return *s_value;
+        return default_value;
+    }
+
+    template <class ValueType>
+        requires std::is_same_v<std::string, ValueType>
+    std::string setting(const compiled_path& setting_path) const
+    {
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
+        if (s_value)
+            return *s_value;
+        return std::string();
+    }
+
+    template <class ValueType>
+        requires std::is_same_v<std::string_view, ValueType>
+    std::string_view setting(const compiled_path& setting_path,
+                             const std::string_view& default_value = std::string_view()) const
+    {
+        const setting_value* s_value = get_setting_value_ptr_(setting_path);
         if (s_value && !s_value->is_default())
             return *s_value;
         return default_value;
     }
 
     // format:
-    inline void format(std::string& var) const { format_(var, this); }
+    // Formatted values of settings are cached in the root of the tree, until the setting or one of the settings it
+    // refers to is modified. Formatting is thus not thread-safe, even through a const section, unless the tree is
+    // published by a config_handle (the cache is then frozen, see config_handle).
+    void format(std::string& var) const;
 
     std::string formatted_setting(const std::string_view& setting_path,
                                   const std::string& default_value = std::string()) const;
 
+    // Replaces the value of every setting of the section tree by its formatted value (this section being the root
+    // used to resolve absolute references). Each setting is formatted once, after the settings it refers to.
+    // Throws std::runtime_error if references are cyclic (ex: 'a = {b}' and 'b = {a}').
+    void resolve_all();
+
     // setting modifiers:
-    bool set_setting(const std::string& setting_path, const std::string& value);
+    bool set_setting(const std::string_view& setting_path, const std::string& value);
 
     template <class ValueType>
         requires(!std::is_same_v<ValueType, std::string>)
-    bool set_setting(const std::string& setting_path, const ValueType& value)
+    bool set_setting(const std::string_view& setting_path, const ValueType& value)
     {
         return set_setting(setting_path, value_to_setting_string(value));
     }
@@ -211,36 +764,204 @@ public:
     // read:
     void read_from_stream(std::istream& stream);
     void read_from_file(const std::filesystem::path& path);
+    void read_from_buffer(std::string_view buffer);
+    // read a directory:
+    struct directory_options
+    {
+        std::string extension;
+        // Number of threads reading the files (0: number of hardware threads).
+        unsigned number_of_threads;
+    };
+    inline static directory_options default_directory_options() { return directory_options{ ".inis", 0 }; }
+    // Reads each file of the directory which has the extension (not recursively) in the subsection named after the
+    // file: 'network.inis' is read in the subsection 'network', which replaces the existing one. The files are mapped
+    // and parsed in parallel, each one in a tree allocated in its own arena, then the trees are inserted in this
+    // section without copy. Each arena is released with its subsection, when the subsection is replaced or erased
+    // too. If a file cannot be read, the exception of the first one (by name) is thrown, and this section is not
+    // modified. The settings directory ($settings_dir) of the root is set to the directory if it has none.
+    void read_from_directory(const std::filesystem::path& dir,
+                             const directory_options& options = default_directory_options());
+    // reload:
+    // Settings added, removed or modified by a reload (full paths from the reloaded section, sorted).
+    struct change_set
+    {
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        std::vector<std::string> modified;
+
+        inline bool empty() const { return added.empty() && removed.empty() && modified.empty(); }
+    };
+
+    // Reads the new content in a new tree, then updates this tree in place: only the changed settings are modified.
+    // The addresses of the sections and of the setting values which are kept do not change.
+    change_set reload_from_stream(std::istream& stream);
+    change_set reload_from_file(const std::filesystem::path& path);
+    change_set reload_from_buffer(std::string_view buffer);
+
     // write:
+    // The text is formatted in a buffer (reused by the next writes of the thread), and written one chunk at a time.
+    // write_to_file() writes the chunks with the write() system call when the platform provides it.
     void write_to_stream(std::ostream& stream, std::string_view default_value_end_marker = "");
-    void write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker);
+    enum class write_mode : std::uint8_t
+    {
+        // The text is written in a temporary file of the same directory, which is renamed to the file without being
+        // synced: a reader sees the old file or the new one, but a crash may lose the new one. The file is not
+        // truncated: a reader which maps it (see mapped_file) keeps the old one. A path which is not a regular file
+        // (a symbolic link, a device, a pipe) is truncated then written.
+        truncate,
+        // The text is written in a temporary file of the same directory, which is synced then renamed to the file:
+        // a reader sees the old file or the new one, even after a crash.
+        atomic,
+        // Only the modified values are written in the file, at the positions recorded by read_from_file() (see
+        // enable_source_spans()): a value of the same length is overwritten in place, otherwise the file is rewritten
+        // from the first modified value. The file is modified in place (not atomically), then synced. If the
+        // positions are not known or not valid anymore, the file is written like in atomic mode.
+        patch,
+    };
+    void write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker,
+                       write_mode mode = write_mode::truncate);
+    // source spans:
+    // When enabled, read_from_file() records the position in the file of each single-line value declared in the file
+    // (not in its included files), for write_to_file() in patch mode. The positions are dropped when the tree is read,
+    // reloaded, moved, or written in this file, and when a setting without position (new, or multi-line) is modified.
+    void enable_source_spans(bool enable = true);
+    inline bool is_source_spans_enabled() const { return root().source_spans_enabled_; }
 
     // settings accessors:
-    const section* subsection_ptr(const std::string& section_path) const;
-    inline const section& subsection(const std::string& section_name) const { return *subsection_ptr(section_name); }
-    section* subsection_ptr(const std::string& section_path);
-    inline section& subsection(const std::string& section_name) { return *subsection_ptr(section_name); }
+    const section* subsection_ptr(const std::string_view& section_path) const;
+    inline const section& subsection(const std::string_view& section_name) const
+    {
+        return *subsection_ptr(section_name);
+    }
+    section* subsection_ptr(const std::string_view& section_path);
+    inline section& subsection(const std::string_view& section_name) { return *subsection_ptr(section_name); }
+
+    // subscriptions:
+    using change_callback = std::function<void(const std::vector<std::string>& changed_paths)>;
+
+    // Calls the callback when set_setting(), create_sections() or a reload changes a setting (or creates a section)
+    // whose full path is path_or_prefix or begins with path_or_prefix followed by a '.'. The path is relative to this
+    // section, and an empty path matches all the changes. The changed paths are full paths from the root, delivered in
+    // one batch per operation (per reload for instance). Returns an identifier to unsubscribe.
+    // The subscriptions move with the tree. A move assignment of a tree without subscriptions keeps the subscriptions
+    // of the assigned tree, and notifies them of the changed settings.
+    std::size_t subscribe(std::string_view path_or_prefix, change_callback callback);
+    void unsubscribe(std::size_t subscription_id);
+
+    // memory:
+    // Estimation of the memory used by the tree (this section and its subsections).
+    struct memory_statistics
+    {
+        std::size_t number_of_sections = 0;
+        std::size_t number_of_settings = 0;
+        std::size_t key_bytes = 0;   // characters of the names stored out of the names (too long for their buffer)
+        std::size_t value_bytes = 0; // characters of the values stored out of the values, and typed value caches
+        std::size_t map_bytes = 0;   // bucket arrays of the dictionaries
+        std::size_t node_bytes = 0;  // nodes of the dictionaries, and section objects
+
+        inline std::size_t total_bytes() const { return key_bytes + value_bytes + map_bytes + node_bytes; }
+    };
+    memory_statistics memory_stats() const;
+
+    // comparison:
+    // Returns the sorted paths of the settings which were added, removed or modified in other, compared to this tree.
+    std::vector<std::string> changed_setting_paths(const section& other) const;
 
 private:
+    // modifiers of the dictionaries, which keep the declaration order:
+    std::pair<settings_dictionnary::iterator, bool> emplace_setting_(std::string_view name, std::string_view value);
+    void assign_setting_(std::string_view name, std::string value);
+    void erase_setting_(settings_dictionnary::iterator iter);
+    // Inserts the subsection, or replaces the subsection with the same name (at the same position).
+    void assign_section_(std::string_view name, std::unique_ptr<section, subsection_deleter>&& subsection);
+    sections_dictionnary::iterator emplace_section_(std::string_view name,
+                                                    std::unique_ptr<section, subsection_deleter>&& subsection);
+    void reorder_like_(const section& other);
     section* create_sections_(const std::string_view& section_path);
-    const setting_value* local_get_setting_value_ptr_(const std::string& setting_name) const;
-    const setting_value* get_setting_value_ptr_(const std::string& setting_path) const;
-    setting_value* get_setting_value_ptr_(const std::string& setting_path);
+    const setting_value* local_get_setting_value_ptr_(const std::string_view& setting_name) const;
+    const setting_value* get_setting_value_ptr_(const std::string_view& setting_path) const;
+    setting_value* get_setting_value_ptr_(const std::string_view& setting_path);
+    const setting_value* get_setting_value_ptr_(const compiled_path& setting_path) const;
+    void touch_structure_();
+    // Generations are unique in the process: a tree never reuses the generation of another one (see compiled_path).
+    static std::uint64_t new_structure_generation_();
+    void enable_typed_value_cache_(bool enable);
+    void enable_concurrent_reads_();
+    struct format_cache;
+    void freeze_formatted_values_(const section* root) const;
+    struct subscription_registry;
+    std::string full_path_() const;
+    bool has_subscriptions_() const;
+    void notify_changes_(const std::vector<std::string>& changed_paths) const;
+    struct source_spans;
+    void start_source_spans_(const std::filesystem::path& canonical_path);
+    void add_source_span_(const setting_value* value, std::size_t offset, std::size_t length);
+    void finish_source_spans_();
+    void discard_source_spans_();
+    void note_value_change_(const setting_value* value);
+    bool patch_file_(const std::filesystem::path& path);
+    void write_file_(const std::filesystem::path& path, std::string_view default_value_end_marker) const;
+    void write_file_atomically_(const std::filesystem::path& path, std::string_view default_value_end_marker,
+                                bool is_synced) const;
+    section make_reloaded_tree_() const;
+    change_set merge_reloaded_tree_(section& new_tree);
+    // is_structure_changed is set if a setting or a section is added or removed.
+    void merge_reloaded_section_(section& new_section, std::string& path, change_set& changes,
+                                 bool& is_structure_changed);
+    void collect_setting_paths_(std::string& path, std::vector<std::string>& setting_paths) const;
+    void collect_memory_stats_(memory_statistics& stats) const;
+    static void collect_changed_setting_paths_(const section* before, const section* after, std::string& path,
+                                               std::vector<std::string>& changed_paths);
+    struct format_part
+    {
+        std::size_t offset;
+        std::size_t length;
+        bool is_reference;
+    };
+
     void format_(std::string& var, const section* root) const;
-    bool get_setting_value_if_exists_(const std::string& setting_path, std::string& value, const section* root) const;
-    void write_to_stream_(std::ostream& stream, const section* const root,
-                          const std::string_view& default_value_end_marker);
+    void append_formatted_(std::string& output, std::string_view text, const std::vector<format_part>& parts,
+                           const section* root) const;
+    const std::string& formatted_value_(const setting_value& value, const section* root) const;
+    // Formatted value, computed without modifying the tree if it is read concurrently (see config_handle).
+    std::string formatted_value_copy_(const setting_value& value, const section* root) const;
+    void append_frozen_formatted_value_(std::string& output, const setting_value& value, const section* root) const;
+    // Formats a value which is not in the format cache. The values it references are added to the cache, unless it is
+    // frozen (nullptr).
+    std::string format_value_(const setting_value& value, const section* root, format_cache* cache) const;
+    const setting_value* resolve_reference_(std::string_view reference, const section* root,
+                                            const section*& owner) const;
+    format_cache& format_cache_of_root_() const;
+    void invalidate_formatted_value_(const setting_value* value);
+    void collect_formatted_values_(std::vector<std::pair<setting_value*, std::string>>& formatted_values,
+                                   const section* root);
+    static void compile_format_(std::string_view text, std::vector<format_part>& parts);
+    class output_buffer;
+    void write_to_buffer_(output_buffer& output, const section* const root, std::size_t depth,
+                          const std::string_view& default_value_end_marker) const;
     static void resolve_implicit_path_part_(std::string_view& path, const section*& section, const class section* root);
     static void resolve_implicit_path_part_(std::string_view& path, section*& sec, const section* root);
     static std::string_view parent_section_path_(const std::string_view& path);
+    inline static bool is_label_char_(char ch) { return char_class_table_[static_cast<unsigned char>(ch)] & Label_char; }
+    inline static bool is_space_char_(char ch) { return char_class_table_[static_cast<unsigned char>(ch)] & Space_char; }
+    static bool is_label_(const std::string_view& str);
     static void split_setting_path_(const std::string_view& setting_path, std::string_view& section_path,
                                     std::string_view& setting);
 
 private:
     section* parent_ = nullptr;
+    std::uint64_t structure_generation_ = new_structure_generation_(); // only used by the root
+    bool typed_value_cache_enabled_ = false;                           // only used by the root
+    bool concurrent_reads_enabled_ = false;                            // only used by the root
+    bool source_spans_enabled_ = false;                                // only used by the root
     std::string name_;
     settings_dictionnary settings_;
-    std::unordered_map<std::string, std::unique_ptr<section>> sections_;
+    sections_dictionnary sections_;
+    ordered_settings setting_order_;
+    ordered_sections section_order_;
+    mutable std::unique_ptr<format_cache> format_cache_; // only used by the root
+    std::unique_ptr<subscription_registry> subscriptions_; // only used by the root
+    std::unique_ptr<source_spans> source_spans_;           // only used by the root
 };
 
 } // namespace inis
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+
+// Instrumentation of the hot paths of the library, disabled by default.
+// Enable it with the CMake option ARBA_INIS_INSTRUMENTATION (which defines ARBA_INIS_INSTRUMENTATION=1). When it is
+// disabled, the ARBA_INIS_* macros expand to nothing (their arguments are not evaluated) and the statistics stay zero.
+#ifndef ARBA_INIS_INSTRUMENTATION
+#define ARBA_INIS_INSTRUMENTATION 0
+#endif
+
+inline namespace arba
+{
+namespace inis
+{
+namespace instrumentation
+{
+
+inline constexpr bool enabled = ARBA_INIS_INSTRUMENTATION;
+
+enum class counter : std::uint8_t
+{
+    parsed_lines,
+    scanned_bytes,
+    lookups,
+    lookup_path_depth, // sum of the numbers of components of the looked-up paths
+    format_expansions,
+    max_format_depth,  // maximum depth of nested reference expansions
+    tree_allocations,  // allocations of section tree nodes (see tree_resource())
+    tree_allocated_bytes,
+    operations, // parses, lookups, format expansions and setting modifications
+};
+inline constexpr std::size_t number_of_counters = static_cast<std::size_t>(counter::operations) + 1;
+
+// Counters are accumulated per thread, without atomic read-modify-write, and summed when the statistics are read.
+// Statistics read (or reset) while other threads are instrumented are approximate.
+struct statistics
+{
+    std::uint64_t parsed_lines = 0;
+    std::uint64_t scanned_bytes = 0;
+    std::uint64_t lookups = 0;
+    std::uint64_t lookup_path_depth = 0;
+    std::uint64_t format_expansions = 0;
+    std::uint64_t max_format_depth = 0;
+    std::uint64_t tree_allocations = 0;
+    std::uint64_t tree_allocated_bytes = 0;
+    std::uint64_t operations = 0;
+
+    inline double mean_lookup_path_depth() const { return lookups ? double(lookup_path_depth) / lookups : 0.; }
+    inline double allocations_per_operation() const { return operations ? double(tree_allocations) / operations : 0.; }
+};
+
+statistics current_statistics();
+void reset_statistics();
+
+void add(counter counter_id, std::uint64_t value);
+void update_max(counter counter_id, std::uint64_t value);
+
+// Counts the depth of nested scopes of the current thread, and keeps the maximum depth in a counter.
+class depth_scope
+{
+public:
+    explicit depth_scope(counter max_counter_id);
+    depth_scope(const depth_scope&) = delete;
+    depth_scope& operator=(const depth_scope&) = delete;
+    ~depth_scope();
+
+private:
+    counter max_counter_id_;
+};
+
+// Keeps in the counter the depth of the current scope (see depth_scope) plus a nested depth, for nested steps kept in
+// an explicit stack rather than in nested scopes.
+void update_max_depth(counter max_counter_id, std::uint64_t nested_depth);
+
+// Memory resource of the section trees built without a memory resource: std::pmr::get_default_resource(), or a
+// resource counting the allocations (on top of std::pmr::new_delete_resource()) when the instrumentation is enabled.
+// Setting values are std::string: their allocations are not counted.
+std::pmr::memory_resource* tree_resource();
+
+// Hook receiving the timing spans of the instrumented operations (parse, reload, write, read of a directory),
+// to export them to a tracer. It is called on the thread of the operation, which must not install another hook.
+using span_hook = void (*)(std::string_view name, std::chrono::steady_clock::time_point start,
+                           std::chrono::nanoseconds duration, void* user_data);
+void set_span_hook(span_hook hook, void* user_data = nullptr);
+
+class scoped_span
+{
+public:
+    explicit scoped_span(std::string_view name);
+    scoped_span(const scoped_span&) = delete;
+    scoped_span& operator=(const scoped_span&) = delete;
+    ~scoped_span();
+
+private:
+    std::string_view name_;
+    span_hook hook_;
+    void* user_data_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace instrumentation
+} // namespace inis
+} // namespace arba
+
+#define ARBA_INIS_INSTRUMENTATION_CONCAT_(lhs, rhs) lhs##rhs
+#define ARBA_INIS_INSTRUMENTATION_NAME_(prefix, line) ARBA_INIS_INSTRUMENTATION_CONCAT_(prefix, line)
+
+#if ARBA_INIS_INSTRUMENTATION
+#define ARBA_INIS_COUNT(counter_name, value)                                                                           \
+    ::arba::inis::instrumentation::add(::arba::inis::instrumentation::counter::counter_name, (value))
+#define ARBA_INIS_DEPTH_SCOPE(counter_name)                                                                            \
+    ::arba::inis::instrumentation::depth_scope ARBA_INIS_INSTRUMENTATION_NAME_(arba_inis_depth_scope_, __LINE__)(     \
+        ::arba::inis::instrumentation::counter::counter_name)
+#define ARBA_INIS_NESTED_DEPTH(counter_name, depth)                                                                    \
+    ::arba::inis::instrumentation::update_max_depth(::arba::inis::instrumentation::counter::counter_name, (depth))
+#define ARBA_INIS_SPAN(name)                                                                                           \
+    ::arba::inis::instrumentation::scoped_span ARBA_INIS_INSTRUMENTATION_NAME_(arba_inis_span_, __LINE__)(name)
+#else
+#define ARBA_INIS_COUNT(counter_name, value) ((void)0)
+#define ARBA_INIS_DEPTH_SCOPE(counter_name) ((void)0)
+#define ARBA_INIS_NESTED_DEPTH(counter_name, depth) ((void)0)
+#define ARBA_INIS_SPAN(name) ((void)0)
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <arba/inis/inis.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Stack of section trees (layers), the last pushed layer having the highest priority (ex: defaults, site, host).
+// A setting is read from the layer with the highest priority which defines it. The effective setting of each path is
+// precomputed in a merged index: a lookup is one hash lookup, whatever the number of layers. When a layer is modified
+// through the layered_config, only the changed paths are computed again.
+// Paths are full paths from the root of the layers ("section.subsection.setting").
+class layered_config
+{
+public:
+    layered_config() = default;
+    layered_config(layered_config&&) = default;
+    layered_config& operator=(layered_config&&) = default;
+
+    // layers:
+    // Pushes a layer above the existing ones and returns its index.
+    std::size_t push_layer(section&& tree);
+    std::size_t push_layer_from_file(const std::filesystem::path& path);
+    inline std::size_t number_of_layers() const { return layers_.size(); }
+    inline const section& layer(std::size_t layer_index) const { return *layers_.at(layer_index); }
+
+    // layer modifiers (they return the paths which were added, removed or modified in the layer):
+    std::vector<std::string> replace_layer(std::size_t layer_index, section&& tree);
+    section::change_set reload_layer_from_file(std::size_t layer_index, const std::filesystem::path& path);
+    section::change_set reload_layer_from_buffer(std::size_t layer_index, std::string_view buffer);
+    bool set_setting(std::size_t layer_index, std::string_view setting_path, const std::string& value);
+
+    template <class ValueType>
+        requires(!std::is_same_v<ValueType, std::string>)
+    bool set_setting(std::size_t layer_index, std::string_view setting_path, const ValueType& value)
+    {
+        return set_setting(layer_index, setting_path, value_to_setting_string(value));
+    }
+
+    // settings accessors:
+    inline bool has_setting(std::string_view setting_path) const { return find_(setting_path) != nullptr; }
+    // Index of the layer which provides the setting, or npos.
+    std::size_t layer_of(std::string_view setting_path) const;
+    inline std::size_t number_of_settings() const { return index_.size(); }
+
+    template <class ValueType>
+        requires(!(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>))
+    ValueType setting(std::string_view setting_path, const ValueType& default_value = ValueType()) const
+    {
+        const effective_setting* effective = find_(setting_path);
+        if (effective)
+            return effective->value->to<ValueType>(default_value);
+        return default_value;
+    }
+
+    template <class ValueType>
+        requires(std::is_same_v<std::string, ValueType> || std::is_same_v<std::string_view, ValueType>)
+    ValueType setting(std::string_view setting_path, std::string_view default_value = std::string_view()) const
+    {
+        const effective_setting* effective = find_(setting_path);
+        if (effective && !effective->value->is_default())
+            return ValueType(*effective->value);
+        return ValueType(default_value);
+    }
+
+    inline constexpr static std::size_t npos = static_cast<std::size_t>(-1);
+
+private:
+    struct effective_setting
+    {
+        const setting_value* value;
+        std::size_t layer_index;
+    };
+
+    using index_dictionnary = std::unordered_map<std::string, effective_setting, string_hash, std::equal_to<>>;
+
+    inline const effective_setting* find_(std::string_view setting_path) const
+    {
+        auto iter = index_.find(setting_path);
+        return iter != index_.end() ? &iter->second : nullptr;
+    }
+    static const setting_value* find_in_layer_(const section& layer, std::string_view setting_path);
+    void index_layer_(std::size_t layer_index, const section& sec, std::string& path);
+    void unindex_layer_(std::size_t layer_index, const section& sec, std::string& path);
+    void update_path_(std::string_view setting_path);
+    void update_paths_(const section::change_set& changes);
+
+private:
+    std::vector<std::unique_ptr<section>> layers_;
+    index_dictionnary index_;
+};
+
+} // namespace inis
+} // namespace arba
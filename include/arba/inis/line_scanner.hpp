@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Offsets of the delimiters of a line, relative to the beginning of the line.
+struct line_delimiters
+{
+    inline constexpr static std::size_t npos = std::string_view::npos;
+
+    std::string_view line;     // the line, without its '\n'
+    std::size_t equal = npos;   // offset of the first '=', or npos
+    std::size_t comment = npos; // offset of the first comment marker, or npos
+};
+
+enum class scan_kernel : uint8_t
+{
+    automatic,
+    scalar,
+    sse2,
+    avx2,
+};
+
+// Splits a buffer in lines, like std::getline does (the last line is the text after the last '\n'),
+// and finds the first '=' and the first comment marker of each line.
+// The buffer is scanned once, 64 bytes at a time, with the best vector instructions of the running CPU.
+class line_scanner
+{
+public:
+    line_scanner(std::string_view buffer, std::string_view comment_marker,
+                 scan_kernel kernel = scan_kernel::automatic);
+
+    inline bool next(line_delimiters& delimiters)
+    {
+        if (line_index_ == line_count_)
+        {
+            if (done_)
+                return false;
+            scan_next_blocks_();
+        }
+        delimiters = lines_[line_index_++];
+        return true;
+    }
+
+    inline scan_kernel kernel() const { return kernel_; }
+    static bool is_supported(scan_kernel kernel);
+    static scan_kernel best_kernel();
+
+    struct block_masks
+    {
+        std::uint64_t newline;
+        std::uint64_t equal;
+        std::uint64_t marker;
+    };
+    using scan_block_function = block_masks (*)(const char* block, char marker);
+    inline constexpr static std::size_t block_size = 64;
+
+private:
+    void scan_next_blocks_();
+    block_masks scan_block_(std::size_t block_offset) const;
+    std::size_t find_comment_(std::uint64_t marker_bits, std::size_t block_offset) const;
+
+private:
+    std::string_view buffer_;
+    std::string_view comment_marker_;
+    scan_kernel kernel_;
+    scan_block_function scan_block_function_;
+    std::size_t block_offset_;
+    // the line being scanned:
+    std::size_t line_begin_;
+    std::size_t line_equal_;
+    std::size_t line_comment_;
+    // lines found in the last scanned block:
+    line_delimiters lines_[block_size];
+    std::size_t line_index_;
+    std::size_t line_count_;
+    bool done_;
+};
+
+} // namespace inis
+} // namespace arba
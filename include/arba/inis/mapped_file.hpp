@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+inline namespace arba
+{
+namespace inis
+{
+
+// Read-only view on the whole content of a file.
+// A big file is memory-mapped when the platform supports it, otherwise the file is read in one shot. The mapping is
+// shared with the file: if another writer truncates it, an access beyond its new end raises SIGBUS. A file must be
+// replaced (see atomic_file_writer) rather than truncated while it is mapped.
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    explicit mapped_file(const std::filesystem::path& path);
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file();
+
+    inline const char* data() const { return data_; }
+    inline std::size_t size() const { return size_; }
+    inline bool empty() const { return size_ == 0; }
+    inline std::string_view view() const { return std::string_view(data_, size_); }
+    inline bool is_mapped() const { return mapped_; }
+
+private:
+    void release_();
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::string buffer_;
+};
+
+// Writer of a file replacing another one atomically: the chunks are written in a temporary file of the same directory,
+// which commit() syncs then renames to the file. A reader sees the old file or the new one, even after a crash, and
+// the replaced file keeps its permissions. The temporary file is removed if the writer is destroyed before commit().
+// Without sync, a reader still sees the old file or the new one, but a crash may lose the new one.
+class atomic_file_writer
+{
+public:
+    explicit atomic_file_writer(const std::filesystem::path& path, bool is_synced = true);
+    atomic_file_writer(const atomic_file_writer&) = delete;
+    atomic_file_writer& operator=(const atomic_file_writer&) = delete;
+    ~atomic_file_writer();
+
+    void write(std::string_view chunk);
+    void commit();
+
+private:
+    void abort_() noexcept;
+
+private:
+    std::filesystem::path path_;
+    std::filesystem::path temporary_path_;
+    int fd_ = -1;               // file descriptor of the temporary file (POSIX)
+    std::FILE* file_ = nullptr; // temporary file (other platforms)
+    bool is_synced_;
+};
+
+} // namespace inis
+} // namespace arba
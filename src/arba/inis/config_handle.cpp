@@ -0,0 +1,44 @@
+#include <arba/inis/config_handle.hpp>
+
+#include <stdexcept>
+
+inline namespace arba
+{
+namespace inis
+{
+
+config_handle::reader::reader(const config_handle& handle)
+    : handle_(&handle), version_(handle.version()), snapshot_(handle.snapshot())
+{
+}
+
+config_handle::config_handle() : config_handle(section())
+{
+}
+
+config_handle::config_handle(section&& tree) : version_(0)
+{
+    publish(std::move(tree));
+}
+
+void config_handle::publish(section&& tree)
+{
+    if (!tree.is_root())
+        throw std::runtime_error("Only a root section can be published.");
+    std::shared_ptr<section> published_tree = std::make_shared<section>(std::move(tree));
+    published_tree->enable_concurrent_reads_();
+    // The snapshot is stored before the version is incremented: a reader which sees the new version loads the new
+    // snapshot (or a newer one).
+    snapshot_.store(std::move(published_tree), std::memory_order_release);
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+void config_handle::read_from_file(const std::filesystem::path& path)
+{
+    section tree;
+    tree.read_from_file(path);
+    publish(std::move(tree));
+}
+
+} // namespace inis
+} // namespace arba
@@ -0,0 +1,491 @@
+#include <arba/inis/document.hpp>
+#include <arba/inis/instrumentation.hpp>
+#include <arba/inis/line_scanner.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+inline namespace arba
+{
+namespace inis
+{
+
+namespace
+{
+
+// A line which ends a multi-line or split value without end marker: an empty line, once its comment is removed.
+bool is_empty_line(std::string_view line, std::string_view comment_marker)
+{
+    line = line.substr(0, line.find(comment_marker));
+    return std::all_of(line.begin(), line.end(), [](char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); });
+}
+
+// Returns true if path is section_path or the path of one of its subsections (all the sections are in the root '').
+bool is_in_section(std::string_view path, std::string_view section_path)
+{
+    return section_path.empty()
+           || (path.starts_with(section_path)
+               && (path.length() == section_path.length() || path[section_path.length()] == '.'));
+}
+
+} // namespace
+
+void document::read_from_file(const std::filesystem::path& path)
+{
+    ARBA_INIS_SPAN("inis.document.read");
+    auto storage = std::make_unique<text_storage>();
+    storage->file = mapped_file(path);
+    const std::string_view text = storage->file.view();
+    read_text_(std::move(storage), text, std::filesystem::canonical(path).parent_path());
+}
+
+void document::read_from_buffer(std::string_view buffer)
+{
+    ARBA_INIS_SPAN("inis.document.read");
+    auto storage = std::make_unique<text_storage>();
+    storage->buffer.assign(buffer);
+    const std::string_view text = storage->buffer;
+    std::filesystem::path settings_dir;
+    auto iter = tree_.settings_.find(section::settings_dir);
+    if (iter != tree_.settings_.end())
+        settings_dir = std::string_view(iter->second);
+    read_text_(std::move(storage), text, settings_dir);
+}
+
+void document::read_text_(std::unique_ptr<text_storage> storage, std::string_view text,
+                          const std::filesystem::path& settings_dir)
+{
+    // The index is built before the previous content is discarded: a bad section header leaves the document unchanged.
+    std::vector<line_span> lines;
+    std::vector<block> blocks;
+    section_dictionary sections;
+    std::vector<const section_dictionary::value_type*> section_order;
+    std::swap(lines, lines_);
+    std::swap(blocks, blocks_);
+    std::swap(sections, sections_);
+    std::swap(section_order, section_order_);
+    const std::string_view previous_text = std::exchange(text_, text);
+    bool has_includes = false;
+    try
+    {
+        has_includes = index_lines_();
+    }
+    catch (...)
+    {
+        std::swap(lines, lines_);
+        std::swap(blocks, blocks_);
+        std::swap(sections, sections_);
+        std::swap(section_order, section_order_);
+        text_ = previous_text;
+        throw;
+    }
+    storage_ = std::move(storage);
+    external_paths_.clear();
+    tree_ = section();
+    section::parser(&tree_).begin_document();
+    if (!settings_dir.empty())
+        tree_.assign_setting_(section::settings_dir, settings_dir.generic_string());
+
+    // The included files can add settings to any section: the whole text is parsed.
+    if (has_includes)
+    {
+        tree();
+        std::string path;
+        collect_external_paths_(tree_, path);
+    }
+}
+
+bool document::index_lines_()
+{
+    ARBA_INIS_SPAN("inis.document.index");
+    bool has_includes = false;
+    auto root_iter = add_section_entry_("");
+    root_iter->second.blocks.push_back(0);
+    blocks_.push_back(block{ npos, 0, 0 });
+
+    // Relative headers ('[..name]') are resolved like the parser does: n dots refer to the ancestor of depth n of the
+    // current section.
+    std::string current_path;
+    std::size_t current_depth = 0;
+    line_scanner scanner(text_, comment_marker_);
+    ARBA_INIS_COUNT(scanned_bytes, text_.size());
+    for (line_delimiters delimiters; scanner.next(delimiters);)
+    {
+        const std::size_t line_index = lines_.size();
+        lines_.push_back(line_span{ static_cast<std::size_t>(delimiters.line.data() - text_.data()),
+                                    delimiters.line.length() });
+        std::string_view header_path;
+        if (section::parser::extract_header_path(delimiters, header_path))
+        {
+            const std::size_t depth = header_path.find_first_not_of('.');
+            if (depth == std::string_view::npos || depth > current_depth)
+                throw std::runtime_error(std::string("The section path is incorrect (Too many '.'): ") += header_path);
+            std::size_t prefix_length = 0;
+            for (std::size_t level = 0; level < depth; ++level)
+            {
+                prefix_length = current_path.find('.', prefix_length + (level > 0));
+                if (prefix_length == std::string::npos)
+                    prefix_length = current_path.length();
+            }
+            current_path.resize(prefix_length);
+            if (!current_path.empty())
+                current_path.push_back('.');
+            current_path.append(header_path.substr(depth));
+            current_depth = std::count(current_path.begin(), current_path.end(), '.') + 1;
+
+            blocks_.back().end_line = line_index;
+            auto iter = add_section_entry_(current_path);
+            iter->second.blocks.push_back(blocks_.size());
+            blocks_.push_back(block{ line_index, line_index + 1, line_index + 1 });
+        }
+        else if (!has_includes && section::parser::has_include_directive(delimiters))
+            has_includes = true;
+    }
+    blocks_.back().end_line = lines_.size();
+    return has_includes;
+}
+
+document::section_dictionary::iterator document::add_section_entry_(std::string_view section_path)
+{
+    auto iter = sections_.find(section_path);
+    if (iter != sections_.end())
+        return iter;
+    // The ancestors are declared before the section, like the parser creates them.
+    if (const std::size_t dot_index = section_path.rfind('.'); dot_index != std::string_view::npos)
+        add_section_entry_(section_path.substr(0, dot_index));
+    iter = sections_.emplace(std::string(section_path), section_entry{}).first;
+    section_order_.push_back(&*iter);
+    return iter;
+}
+
+bool document::is_parsed(std::string_view section_path) const
+{
+    auto iter = sections_.find(section_path);
+    return iter != sections_.end() && iter->second.is_parsed;
+}
+
+section* document::section_ptr(std::string_view section_path)
+{
+    auto iter = sections_.find(section_path);
+    if (iter == sections_.end())
+        return tree_.subsection_ptr(section_path);
+    // The subsections are parsed too: the returned section is complete.
+    for (const section_dictionary::value_type* entry : section_order_)
+    {
+        if (is_in_section(entry->first, section_path))
+            parse_section_(const_cast<section_dictionary::value_type&>(*entry));
+    }
+    return parse_section_(*iter);
+}
+
+section* document::local_section_ptr_(std::string_view section_path)
+{
+    auto iter = sections_.find(section_path);
+    if (iter != sections_.end())
+        return parse_section_(*iter);
+    return tree_.subsection_ptr(section_path);
+}
+
+section& document::tree()
+{
+    for (const section_dictionary::value_type* entry : section_order_)
+        parse_section_(const_cast<section_dictionary::value_type&>(*entry));
+    return tree_;
+}
+
+section* document::parse_section_(section_dictionary::value_type& entry)
+{
+    section* sec = entry.first.empty() ? &tree_ : tree_.create_sections(entry.first);
+    section_entry& sec_entry = entry.second;
+    if (sec_entry.is_parsed)
+        return sec;
+    ARBA_INIS_SPAN("inis.document.parse_section");
+    sec_entry.is_parsed = true;
+
+    // The lines of the blocks are read by the parser. The lines of a multi-line or split value are the lines read
+    // while the parser reads the value, and the line which ends it (an end marker, not an empty line).
+    section::parser inis_parser(&tree_);
+    std::vector<setting_source>& sources = sec_entry.settings;
+    for (std::size_t block_index : sec_entry.blocks)
+    {
+        const block& sec_block = blocks_[block_index];
+        inis_parser.begin_block(sec);
+        std::size_t open_source_index = npos;
+        const setting_value* open_value = nullptr;
+        auto close_open_source = [&]
+        {
+            if (open_source_index != npos)
+                sources[open_source_index].original_value = *open_value;
+            open_source_index = npos;
+        };
+        for (std::size_t line_index = sec_block.first_line; line_index < sec_block.end_line; ++line_index)
+        {
+            const std::string_view line = text_.substr(lines_[line_index].offset, lines_[line_index].length);
+            const section::parser::declared_setting declared = inis_parser.read_block_line(line);
+            if (declared.value_ptr)
+            {
+                close_open_source();
+                const bool is_single_line = !inis_parser.is_reading_value();
+                sources.push_back(setting_source{
+                    declared.name, line_index, line_index,
+                    is_single_line ? static_cast<std::size_t>(declared.value.data() - text_.data()) : 0,
+                    declared.value.length(), is_single_line, std::string() });
+                if (!is_single_line)
+                {
+                    open_source_index = sources.size() - 1;
+                    open_value = declared.value_ptr;
+                }
+            }
+            else if (open_source_index != npos)
+            {
+                if (inis_parser.is_reading_value() || !is_empty_line(line, comment_marker_))
+                    sources[open_source_index].last_line = line_index;
+                if (!inis_parser.is_reading_value())
+                    close_open_source();
+            }
+        }
+        close_open_source();
+    }
+    return sec;
+}
+
+const setting_value* document::find_setting_(std::string_view setting_path)
+{
+    const std::size_t dot_index = setting_path.rfind('.');
+    const std::string_view section_path =
+        dot_index != std::string_view::npos ? setting_path.substr(0, dot_index) : std::string_view();
+    const section* sec = local_section_ptr_(section_path);
+    if (!sec)
+        return nullptr;
+    auto iter = sec->settings().find(setting_path.substr(dot_index + 1));
+    return iter != sec->settings().end() ? &iter->second : nullptr;
+}
+
+bool document::set_setting(std::string_view setting_path, const std::string& value)
+{
+    const std::size_t dot_index = setting_path.rfind('.');
+    const std::string_view section_path =
+        dot_index != std::string_view::npos ? setting_path.substr(0, dot_index) : std::string_view();
+    section* sec = local_section_ptr_(section_path);
+    if (!sec)
+        sec = tree_.create_sections(section_path);
+    return sec && sec->set_setting(setting_path.substr(dot_index + 1), value);
+}
+
+void document::collect_external_paths_(const section& sec, std::string& path)
+{
+    // Called once the whole text is parsed: the settings without source come from the included files.
+    const std::size_t path_length = path.length();
+    auto iter = sections_.find(path.empty() ? std::string_view() : std::string_view(path).substr(0, path_length - 1));
+    std::unordered_set<std::string_view> source_names;
+    if (iter != sections_.end())
+    {
+        for (const setting_source& source : iter->second.settings)
+            source_names.insert(source.name);
+    }
+    for (const auto* entry : sec.settings_in_order())
+    {
+        if (entry->first.front() != '$' && !source_names.contains(entry->first))
+            external_paths_.insert(path + std::string(entry->first));
+    }
+    for (const auto* entry : sec.sections_in_order())
+    {
+        path.append(entry->first).push_back('.');
+        collect_external_paths_(*entry->second, path);
+        path.resize(path_length);
+    }
+}
+
+void document::append_setting_(std::string& output, std::string_view name, std::string_view value,
+                               std::string_view default_value_end_marker)
+{
+    // Same format as section::write_to_stream().
+    output.append(name);
+    if (value.find('\n') == std::string_view::npos)
+        output.append(" = ").append(value);
+    else
+    {
+        output.append(" =| ").append(default_value_end_marker).append("\n");
+        output.append(value).append("\n").append(default_value_end_marker);
+    }
+}
+
+void document::collect_edits_(std::vector<text_edit>& edits, std::string& appended_text,
+                              std::string_view default_value_end_marker) const
+{
+    // The sections which were not parsed are written as they are.
+    std::string path;
+    for (const section_dictionary::value_type* entry : section_order_)
+    {
+        const section_entry& sec_entry = entry->second;
+        if (!sec_entry.is_parsed)
+            continue;
+        const section* sec = entry->first.empty() ? &tree_ : tree_.subsection_ptr(entry->first);
+        auto lines_end = [this](std::size_t line_index)
+        { return line_index + 1 < lines_.size() ? lines_[line_index + 1].offset : text_.size(); };
+        if (!sec)
+        {
+            // The section was removed from the tree: so are its blocks.
+            for (std::size_t block_index : sec_entry.blocks)
+            {
+                const block& sec_block = blocks_[block_index];
+                if (sec_block.header_line != npos)
+                    edits.push_back(
+                        text_edit{ lines_[sec_block.header_line].offset, lines_end(sec_block.end_line - 1), {} });
+            }
+            continue;
+        }
+
+        // New settings are inserted after the last setting of the text which is kept, or after the first header.
+        std::size_t insertion_offset = npos;
+        if (!sec_entry.blocks.empty())
+        {
+            const block& first_block = blocks_[sec_entry.blocks.front()];
+            insertion_offset = first_block.header_line != npos ? line_end_(first_block.header_line) : 0;
+        }
+        std::unordered_set<std::string_view> source_names;
+        for (const setting_source& source : sec_entry.settings)
+        {
+            source_names.insert(source.name);
+            auto iter = sec->settings().find(source.name);
+            if (iter == sec->settings().end())
+            {
+                edits.push_back(text_edit{ lines_[source.first_line].offset, lines_end(source.last_line), {} });
+                continue;
+            }
+            insertion_offset = line_end_(source.last_line);
+            const std::string_view value = iter->second;
+            if (source.is_single_line)
+            {
+                if (value == text_.substr(source.value_offset, source.value_length))
+                    continue;
+                // Only the value is replaced: the spaces and the comment of the line are kept.
+                if (value.find('\n') == std::string_view::npos)
+                {
+                    const std::size_t value_end = source.value_offset + source.value_length;
+                    edits.push_back(text_edit{ source.value_offset, value_end, std::string(value) });
+                    continue;
+                }
+            }
+            else if (value == source.original_value)
+                continue;
+            text_edit edit{ lines_[source.first_line].offset, line_end_(source.last_line), {} };
+            append_setting_(edit.text, source.name, value, default_value_end_marker);
+            edits.push_back(std::move(edit));
+        }
+
+        path.assign(entry->first);
+        if (!path.empty())
+            path.push_back('.');
+        const std::size_t path_length = path.length();
+        std::string new_settings;
+        for (const auto* setting : sec->settings_in_order())
+        {
+            if (setting->first.front() == '$' || source_names.contains(setting->first))
+                continue;
+            path.append(setting->first);
+            const bool is_external = external_paths_.contains(path);
+            path.resize(path_length);
+            if (is_external)
+                continue;
+            new_settings.push_back('\n');
+            append_setting_(new_settings, setting->first, setting->second, default_value_end_marker);
+        }
+        if (new_settings.empty())
+            continue;
+        if (insertion_offset == npos)
+        {
+            // The section is only declared as the ancestor of other sections: it gets its own header.
+            appended_text.append("\n[").append(entry->first).append("]").append(new_settings).append("\n");
+        }
+        else if (insertion_offset == 0)
+            edits.push_back(text_edit{ 0, 0, new_settings.substr(1) + "\n" });
+        else
+            edits.push_back(text_edit{ insertion_offset, insertion_offset, std::move(new_settings) });
+    }
+    path.clear();
+    collect_new_sections_(tree_, path, appended_text, default_value_end_marker);
+}
+
+void document::collect_new_sections_(const section& sec, std::string& path, std::string& appended_text,
+                                     std::string_view default_value_end_marker) const
+{
+    const std::size_t path_length = path.length();
+    for (const auto* entry : sec.sections_in_order())
+    {
+        path.append(entry->first);
+        const std::size_t section_path_length = path.length();
+        if (!sections_.contains(path))
+        {
+            std::string new_settings;
+            path.push_back('.');
+            for (const auto* setting : entry->second->settings_in_order())
+            {
+                path.append(setting->first);
+                const bool is_external = external_paths_.contains(path);
+                path.resize(section_path_length + 1);
+                if (is_external)
+                    continue;
+                new_settings.push_back('\n');
+                append_setting_(new_settings, setting->first, setting->second, default_value_end_marker);
+            }
+            path.resize(section_path_length);
+            if (!new_settings.empty())
+                appended_text.append("\n[").append(path).append("]").append(new_settings).append("\n");
+        }
+        path.push_back('.');
+        collect_new_sections_(*entry->second, path, appended_text, default_value_end_marker);
+        path.resize(path_length);
+    }
+}
+
+template <class Sink>
+void document::write_(Sink&& write_chunk, std::string_view default_value_end_marker) const
+{
+    ARBA_INIS_SPAN("inis.document.write");
+    std::vector<text_edit> edits;
+    std::string appended_text;
+    collect_edits_(edits, appended_text, default_value_end_marker);
+    std::sort(edits.begin(), edits.end(), [](const text_edit& lhs, const text_edit& rhs)
+              { return lhs.begin != rhs.begin ? lhs.begin < rhs.begin : lhs.end < rhs.end; });
+
+    // The text between the edits is written as it is.
+    std::size_t offset = 0;
+    for (const text_edit& edit : edits)
+    {
+        if (edit.begin > offset)
+            write_chunk(text_.substr(offset, edit.begin - offset));
+        write_chunk(std::string_view(edit.text));
+        offset = std::max(offset, edit.end);
+    }
+    if (offset < text_.size())
+        write_chunk(text_.substr(offset));
+    if (!appended_text.empty())
+    {
+        // The appended sections are separated from the text by an empty line.
+        if (text_.empty())
+            appended_text.erase(0, 1);
+        else if (text_.back() != '\n')
+            write_chunk(std::string_view("\n"));
+        write_chunk(std::string_view(appended_text));
+    }
+}
+
+void document::write_to_stream(std::ostream& stream, std::string_view default_value_end_marker) const
+{
+    auto write_chunk = [&stream](std::string_view chunk)
+    { stream.write(chunk.data(), static_cast<std::streamsize>(chunk.size())); };
+    write_(write_chunk, default_value_end_marker);
+    stream.flush();
+}
+
+void document::write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker) const
+{
+    // The text may be mapped from the file: the file is replaced (not modified in place).
+    atomic_file_writer writer(path);
+    write_([&writer](std::string_view chunk) { writer.write(chunk); }, default_value_end_marker);
+    writer.commit();
+}
+
+} // namespace inis
+} // namespace arba
@@ -0,0 +1,613 @@
+#include <arba/inis/file_watcher.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#if __has_include(<sys/inotify.h>)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define ARBA_INIS_HAS_INOTIFY 1
+#else
+#define ARBA_INIS_HAS_INOTIFY 0
+#endif
+
+inline namespace arba
+{
+namespace inis
+{
+
+namespace
+{
+
+struct file_status
+{
+    std::filesystem::file_time_type last_write_time;
+    std::uintmax_t size = 0;
+
+    bool operator==(const file_status&) const = default;
+};
+
+file_status read_file_status(const std::filesystem::path& path)
+{
+    std::error_code error;
+    file_status status;
+    status.last_write_time = std::filesystem::last_write_time(path, error);
+    status.size = std::filesystem::file_size(path, error);
+    return status;
+}
+
+} // namespace
+
+// A file read to build the tree of a watched file: the watched file, or a file it includes.
+struct file_watcher::watched_source
+{
+    std::filesystem::path path;
+    // inotify backend:
+    int watch_descriptor = -1;
+    // polling backend:
+    file_status status;
+};
+
+struct file_watcher::watched_file
+{
+    std::filesystem::path path;
+    config_handle* handle = nullptr;
+    snapshot_ptr tree;
+    bool is_watched = true;
+    bool is_loading = false; // true while watch() reads the file: it is not reloaded yet
+    std::vector<watched_source> sources; // the file, then the files it includes
+    // debounce:
+    bool is_pending = false;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+file_watcher::file_watcher(std::chrono::milliseconds debounce_delay, backend watch_backend,
+                           std::chrono::milliseconds poll_interval)
+    : debounce_delay_(debounce_delay), poll_interval_(poll_interval), backend_(watch_backend)
+{
+    if (backend_ == backend::automatic)
+        backend_ = is_supported(backend::inotify) ? backend::inotify : backend::polling;
+    else if (!is_supported(backend_))
+        throw std::runtime_error("The file watcher backend is not supported on this platform.");
+
+#if ARBA_INIS_HAS_INOTIFY
+    if (backend_ == backend::inotify)
+    {
+        inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0)
+            throw std::system_error(errno, std::generic_category(), "inotify_init1");
+        if (::pipe2(wake_fds_, O_NONBLOCK | O_CLOEXEC) != 0)
+        {
+            int error = errno;
+            ::close(inotify_fd_);
+            throw std::system_error(error, std::generic_category(), "pipe2");
+        }
+    }
+#endif
+
+    thread_ = std::thread(&file_watcher::run_, this);
+}
+
+file_watcher::~file_watcher()
+{
+    stop_();
+}
+
+bool file_watcher::is_supported(backend watch_backend)
+{
+    switch (watch_backend)
+    {
+    case backend::inotify:
+        return ARBA_INIS_HAS_INOTIFY;
+    default:
+        return true;
+    }
+}
+
+file_watcher::snapshot_ptr file_watcher::watch(const std::filesystem::path& path)
+{
+    watch_(path, nullptr);
+    return tree(path);
+}
+
+void file_watcher::watch(const std::filesystem::path& path, config_handle& handle)
+{
+    watch_(path, &handle);
+}
+
+void file_watcher::watch_(const std::filesystem::path& path, config_handle* handle)
+{
+    auto file = std::make_shared<watched_file>();
+    file->path = std::filesystem::absolute(path).lexically_normal();
+    file->handle = handle;
+    file->is_loading = true;
+    // The status is read, the directory is watched, and the file is registered before the file is read: a
+    // modification made while it is read is detected, and the file is reloaded once it is read.
+    watched_source& source = file->sources.emplace_back();
+    source.path = file->path;
+    source.status = read_file_status(file->path);
+    std::shared_ptr<watched_file> replaced_file;
+    {
+        std::lock_guard lock(mutex_);
+        source.watch_descriptor = add_watch_(file->path);
+        auto iter =
+            std::find_if(files_.begin(), files_.end(), [&](const auto& entry) { return entry->path == file->path; });
+        if (iter != files_.end())
+        {
+            // The previous tree stays available until the new one is read.
+            replaced_file = std::move(*iter);
+            file->tree = replaced_file->tree;
+            *iter = file;
+        }
+        else
+            files_.push_back(file);
+    }
+
+    snapshot_ptr tree;
+    std::vector<std::filesystem::path> included_paths;
+    try
+    {
+        section new_tree;
+        std::exception_ptr error;
+        included_paths = read_file_(file->path, new_tree, error);
+        if (error)
+            std::rethrow_exception(error);
+        if (handle)
+        {
+            handle->publish(std::move(new_tree));
+            tree = handle->snapshot();
+        }
+        else
+            tree = std::make_shared<const section>(std::move(new_tree));
+    }
+    catch (...)
+    {
+        // The replaced file is watched again (unless the file was unwatched meanwhile).
+        std::lock_guard lock(mutex_);
+        auto iter = std::find(files_.begin(), files_.end(), file);
+        if (iter != files_.end())
+        {
+            if (replaced_file)
+                *iter = std::move(replaced_file);
+            else
+                files_.erase(iter);
+            release_watches_(*file);
+        }
+        throw;
+    }
+    // The included files are only known once the file is read: a modification made meanwhile is not detected.
+    std::vector<watched_source> included_sources = make_sources_(included_paths);
+
+    // The replaced file may be reloading: its handle must not be used once watch() returns.
+    std::unique_lock<std::mutex> reload_lock;
+    if (replaced_file)
+        reload_lock = std::unique_lock(reload_mutex_);
+    std::lock_guard lock(mutex_);
+    if (file->is_watched)
+        update_included_sources_(*file, std::move(included_sources));
+    file->tree = std::move(tree);
+    file->is_loading = false;
+    if (file->is_pending)
+        wake_();
+    if (replaced_file)
+    {
+        replaced_file->is_watched = false;
+        release_watches_(*replaced_file);
+    }
+}
+
+void file_watcher::unwatch(const std::filesystem::path& path)
+{
+    const std::filesystem::path absolute_path = std::filesystem::absolute(path).lexically_normal();
+    // A reload in progress is waited for: the handle of the file is not used once unwatch() returns.
+    std::lock_guard reload_lock(reload_mutex_);
+    std::lock_guard lock(mutex_);
+    auto iter =
+        std::find_if(files_.begin(), files_.end(), [&](const auto& file) { return file->path == absolute_path; });
+    if (iter == files_.end())
+        return;
+    std::shared_ptr<watched_file> file = std::move(*iter);
+    files_.erase(iter);
+    file->is_watched = false;
+    release_watches_(*file);
+}
+
+std::vector<std::filesystem::path> file_watcher::read_file_(const std::filesystem::path& path, section& tree,
+                                                           std::exception_ptr& error)
+{
+    section::parser inis_parser(&tree);
+    try
+    {
+        inis_parser.parse(path);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    std::vector<std::string> included_paths = inis_parser.included_paths();
+    return std::vector<std::filesystem::path>(included_paths.begin(), included_paths.end());
+}
+
+std::vector<file_watcher::watched_source>
+file_watcher::make_sources_(const std::vector<std::filesystem::path>& paths) const
+{
+    std::vector<watched_source> sources(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        sources[i].path = paths[i];
+        if (backend_ == backend::polling)
+            sources[i].status = read_file_status(paths[i]);
+    }
+    return sources;
+}
+
+void file_watcher::update_included_sources_(watched_file& file, std::vector<watched_source> included_sources)
+{
+    // The sources of the files still included are kept, so that their watches and their statuses are not reset.
+    std::vector<watched_source> sources;
+    sources.reserve(included_sources.size() + 1);
+    sources.push_back(std::move(file.sources.front()));
+    file.sources.front().watch_descriptor = -1;
+    for (watched_source& included_source : included_sources)
+    {
+        auto iter = std::find_if(file.sources.begin() + 1, file.sources.end(),
+                                 [&](const watched_source& source) { return source.path == included_source.path; });
+        if (iter != file.sources.end())
+        {
+            sources.push_back(std::move(*iter));
+            iter->watch_descriptor = -1;
+            continue;
+        }
+        watched_source& source = sources.emplace_back(std::move(included_source));
+        // The file is still watched if the directory of an included file cannot be watched.
+        try
+        {
+            source.watch_descriptor = add_watch_(source.path);
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << "WARNING: The file '" << source.path.generic_string()
+                      << "' included by a watched file cannot be watched: " << error.what() << std::endl;
+        }
+    }
+    release_watches_(file);
+    file.sources = std::move(sources);
+}
+
+int file_watcher::add_watch_(const std::filesystem::path& path)
+{
+#if ARBA_INIS_HAS_INOTIFY
+    if (backend_ == backend::inotify)
+    {
+        // The directory is watched: editors often replace a file by renaming a new one.
+        constexpr std::uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+        const int watch_descriptor = ::inotify_add_watch(inotify_fd_, path.parent_path().c_str(), mask);
+        if (watch_descriptor < 0)
+            throw std::filesystem::filesystem_error("inotify_add_watch", path.parent_path(),
+                                                    std::error_code(errno, std::generic_category()));
+        ++watch_references_[watch_descriptor];
+        return watch_descriptor;
+    }
+#else
+    (void)path;
+#endif
+    return -1;
+}
+
+void file_watcher::release_watches_(watched_file& file)
+{
+#if ARBA_INIS_HAS_INOTIFY
+    // A directory stays watched while another file of the directory is watched.
+    for (watched_source& source : file.sources)
+    {
+        if (source.watch_descriptor < 0)
+            continue;
+        auto iter = watch_references_.find(source.watch_descriptor);
+        if (iter != watch_references_.end() && --iter->second == 0)
+        {
+            watch_references_.erase(iter);
+            ::inotify_rm_watch(inotify_fd_, source.watch_descriptor);
+        }
+        source.watch_descriptor = -1;
+    }
+#else
+    (void)file;
+#endif
+}
+
+void file_watcher::wake_()
+{
+    woken_ = true;
+    condition_.notify_all();
+#if ARBA_INIS_HAS_INOTIFY
+    if (wake_fds_[1] >= 0)
+    {
+        const char byte = 0;
+        [[maybe_unused]] ssize_t result = ::write(wake_fds_[1], &byte, 1);
+    }
+#endif
+}
+
+file_watcher::snapshot_ptr file_watcher::tree(const std::filesystem::path& path) const
+{
+    const std::filesystem::path absolute_path = std::filesystem::absolute(path).lexically_normal();
+    std::lock_guard lock(mutex_);
+    auto iter =
+        std::find_if(files_.begin(), files_.end(), [&](const auto& file) { return file->path == absolute_path; });
+    return iter != files_.end() ? (*iter)->tree : nullptr;
+}
+
+std::size_t file_watcher::add_callback(callback function)
+{
+    std::lock_guard lock(mutex_);
+    callbacks_.emplace_back(next_callback_id_, std::move(function));
+    return next_callback_id_++;
+}
+
+void file_watcher::remove_callback(std::size_t callback_id)
+{
+    std::lock_guard lock(mutex_);
+    std::erase_if(callbacks_, [callback_id](const auto& entry) { return entry.first == callback_id; });
+}
+
+void file_watcher::run_()
+{
+    for (;;)
+    {
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        {
+            std::lock_guard lock(mutex_);
+            if (stopped_)
+                return;
+            for (const auto& file : files_)
+            {
+                if (file->is_pending && !file->is_loading)
+                    deadline = std::min(deadline, file->deadline);
+            }
+        }
+
+        wait_for_events_(deadline);
+
+        std::vector<std::shared_ptr<watched_file>> due_files;
+        {
+            std::lock_guard lock(mutex_);
+            if (stopped_)
+                return;
+            const auto now = std::chrono::steady_clock::now();
+            for (const auto& file : files_)
+            {
+                if (file->is_pending && !file->is_loading && file->deadline <= now)
+                {
+                    file->is_pending = false;
+                    due_files.push_back(file);
+                }
+            }
+        }
+        for (const auto& file : due_files)
+            reload_(*file);
+    }
+}
+
+void file_watcher::wait_for_events_(std::chrono::steady_clock::time_point deadline)
+{
+#if ARBA_INIS_HAS_INOTIFY
+    if (backend_ == backend::inotify)
+    {
+        int timeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max())
+        {
+            auto delay = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0));
+        }
+        pollfd fds[2] = { { inotify_fd_, POLLIN, 0 }, { wake_fds_[0], POLLIN, 0 } };
+        if (::poll(fds, 2, timeout) > 0)
+        {
+            if (fds[1].revents & POLLIN)
+            {
+                char buffer[64];
+                while (::read(wake_fds_[0], buffer, sizeof(buffer)) > 0)
+                {
+                }
+            }
+            if (fds[0].revents & POLLIN)
+                read_inotify_events_();
+        }
+        return;
+    }
+#endif
+
+    {
+        std::unique_lock lock(mutex_);
+        const auto poll_time = std::chrono::steady_clock::now() + poll_interval_;
+        condition_.wait_until(lock, std::min(deadline, poll_time), [this] { return stopped_ || woken_; });
+        woken_ = false;
+        if (stopped_)
+            return;
+    }
+    poll_files_();
+}
+
+void file_watcher::read_inotify_events_()
+{
+#if ARBA_INIS_HAS_INOTIFY
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t length = ::read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0)
+            return;
+
+        std::lock_guard lock(mutex_);
+        const auto deadline = std::chrono::steady_clock::now() + debounce_delay_;
+        for (const char* iter = buffer; iter < buffer + length;)
+        {
+            const inotify_event& event = *reinterpret_cast<const inotify_event*>(iter);
+            iter += sizeof(inotify_event) + event.len;
+            const bool overflow = event.mask & IN_Q_OVERFLOW;
+            if (!overflow && event.len == 0)
+                continue;
+            const std::string_view name = overflow ? std::string_view() : std::string_view(event.name);
+            auto is_source = [&](const watched_source& source)
+            { return source.watch_descriptor == event.wd && source.path.filename() == name; };
+            for (const auto& file : files_)
+            {
+                if (overflow || std::any_of(file->sources.begin(), file->sources.end(), is_source))
+                {
+                    file->is_pending = true;
+                    file->deadline = deadline;
+                }
+            }
+        }
+    }
+#endif
+}
+
+void file_watcher::poll_files_()
+{
+    std::vector<std::shared_ptr<watched_file>> files;
+    std::vector<std::vector<std::filesystem::path>> paths;
+    {
+        std::lock_guard lock(mutex_);
+        files = files_;
+        paths.reserve(files.size());
+        for (const auto& file : files)
+        {
+            std::vector<std::filesystem::path>& file_paths = paths.emplace_back();
+            for (const watched_source& source : file->sources)
+                file_paths.push_back(source.path);
+        }
+    }
+
+    // The files are examined without the lock, which would block the readers of the trees while the disk is slow.
+    std::vector<std::vector<file_status>> statuses;
+    statuses.reserve(files.size());
+    for (const auto& file_paths : paths)
+    {
+        std::vector<file_status>& file_statuses = statuses.emplace_back();
+        for (const std::filesystem::path& path : file_paths)
+            file_statuses.push_back(read_file_status(path));
+    }
+
+    // The sources are matched by path: the included files may have changed meanwhile.
+    std::lock_guard lock(mutex_);
+    const auto deadline = std::chrono::steady_clock::now() + debounce_delay_;
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        watched_file& file = *files[i];
+        for (std::size_t j = 0; j < paths[i].size(); ++j)
+        {
+            auto iter = std::find_if(file.sources.begin(), file.sources.end(),
+                                     [&](const watched_source& source) { return source.path == paths[i][j]; });
+            if (iter != file.sources.end() && iter->status != statuses[i][j])
+            {
+                iter->status = statuses[i][j];
+                file.is_pending = true;
+                file.deadline = deadline;
+            }
+        }
+    }
+}
+
+void file_watcher::reload_(watched_file& file)
+{
+    section new_tree;
+    std::exception_ptr error;
+    std::vector<watched_source> included_sources = make_sources_(read_file_(file.path, new_tree, error));
+    {
+        // The included files are watched even if the file cannot be read: it is reloaded once they are fixed. The read
+        // may have stopped before some include directives, so the files included before stay watched.
+        std::lock_guard lock(mutex_);
+        if (!file.is_watched)
+            return;
+        for (std::size_t i = 1; error && i < file.sources.size(); ++i)
+        {
+            const std::filesystem::path& path = file.sources[i].path;
+            if (std::none_of(included_sources.begin(), included_sources.end(),
+                             [&](const watched_source& source) { return source.path == path; }))
+                included_sources.push_back(watched_source{ path, -1, file.sources[i].status });
+        }
+        update_included_sources_(file, std::move(included_sources));
+    }
+    if (error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const std::exception& exception)
+        {
+            std::cerr << "WARNING: The file '" << file.path.generic_string()
+                      << "' cannot be reloaded: " << exception.what() << std::endl;
+        }
+        return;
+    }
+
+    // The trees are compared, and the new one is published, without holding the mutex: tree(), watch() and the
+    // other operations are not blocked meanwhile. The tree of the file is only replaced by this thread.
+    snapshot_ptr tree;
+    {
+        std::lock_guard lock(mutex_);
+        if (!file.is_watched)
+            return;
+        tree = file.tree;
+    }
+    change_event event;
+    event.changed_setting_paths = tree->changed_setting_paths(new_tree);
+    if (event.changed_setting_paths.empty())
+        return;
+
+    {
+        // unwatch() waits for the publication: the handle is valid while the file is watched.
+        std::lock_guard reload_lock(reload_mutex_);
+        {
+            std::lock_guard lock(mutex_);
+            if (!file.is_watched)
+                return;
+        }
+        if (file.handle)
+        {
+            file.handle->publish(std::move(new_tree));
+            tree = file.handle->snapshot();
+        }
+        else
+            tree = std::make_shared<const section>(std::move(new_tree));
+    }
+
+    std::vector<std::pair<std::size_t, callback>> callbacks;
+    {
+        std::lock_guard lock(mutex_);
+        file.tree = tree;
+        event.path = file.path;
+        event.tree = std::move(tree);
+        callbacks = callbacks_;
+    }
+    for (const auto& entry : callbacks)
+        entry.second(event);
+}
+
+void file_watcher::stop_()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopped_ = true;
+        wake_();
+    }
+    if (thread_.joinable())
+        thread_.join();
+#if ARBA_INIS_HAS_INOTIFY
+    for (int fd : { inotify_fd_, wake_fds_[0], wake_fds_[1] })
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+#endif
+}
+
+} // namespace inis
+} // namespace arba
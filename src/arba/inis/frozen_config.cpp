@@ -0,0 +1,320 @@
+#include <arba/inis/frozen_config.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+inline namespace arba
+{
+namespace inis
+{
+
+namespace
+{
+
+// Names are ordered by length first: most comparisons of a binary search are then integer comparisons.
+inline bool name_less(std::string_view lhs, std::string_view rhs)
+{
+    if (lhs.length() != rhs.length())
+        return lhs.length() < rhs.length();
+    return lhs < rhs;
+}
+
+template <class Node>
+const Node* find_node(const Node* first, std::uint32_t count, std::string_view name, const char* string_pool)
+{
+    const Node* last = first + count;
+    const Node* iter = std::lower_bound(
+        first, last, name,
+        [&string_pool](const Node& node, std::string_view name)
+        {
+            if (node.name.length != name.length())
+                return node.name.length < name.length();
+            return std::string_view(string_pool + node.name.offset, node.name.length) < name;
+        });
+    if (iter != last && std::string_view(string_pool + iter->name.offset, iter->name.length) == name)
+        return iter;
+    return nullptr;
+}
+
+std::uint32_t checked_index(std::size_t index)
+{
+    if (index > std::numeric_limits<std::uint32_t>::max()) [[unlikely]]
+        throw std::runtime_error("The section tree is too big to be frozen.");
+    return static_cast<std::uint32_t>(index);
+}
+
+constexpr char image_magic[8] = { 'A', 'R', 'B', 'A', 'I', 'N', 'I', 'S' };
+constexpr std::uint32_t image_byte_order_mark = 0x01020304;
+
+std::uint64_t fnv1a_hash(std::string_view bytes)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char byte : bytes)
+    {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+[[noreturn]] void throw_invalid_image(const char* reason)
+{
+    throw std::runtime_error(std::string("Invalid binary inis image: ") += reason);
+}
+
+} // namespace
+
+frozen_config::frozen_config() : frozen_config(section())
+{
+}
+
+frozen_config::frozen_config(const section& root, value_mode mode)
+{
+    std::string string_pool;
+    std::vector<section_node> sections;
+    std::vector<setting_node> settings;
+
+    // Identical strings (names and values) are stored once in the pool.
+    // The pooled strings are owned by the tree, which is not modified while it is frozen, or by formatted_values.
+    std::deque<std::string> formatted_values;
+    std::unordered_map<std::string_view, string_ref> pooled_strings;
+    auto pool_string = [&](std::string_view str)
+    {
+        auto [iter, is_new] = pooled_strings.try_emplace(str);
+        if (is_new)
+        {
+            iter->second.offset = checked_index(string_pool.size());
+            iter->second.length = checked_index(str.size());
+            string_pool.append(str);
+            checked_index(string_pool.size());
+        }
+        return iter->second;
+    };
+
+    // Breadth-first traversal: the subsections of a section are consecutive in sections.
+    std::vector<const section*> source_sections{ &root };
+    sections.emplace_back().name = pool_string(root.name());
+    for (std::size_t index = 0; index < source_sections.size(); ++index)
+    {
+        const section& source = *source_sections[index];
+
+        std::vector<const section::settings_dictionnary::value_type*> source_settings;
+        source_settings.reserve(source.settings_.size());
+        for (const auto& entry : source.settings_)
+            source_settings.push_back(&entry);
+        std::sort(source_settings.begin(), source_settings.end(),
+                  [](const auto* lhs, const auto* rhs) { return name_less(lhs->first, rhs->first); });
+        sections[index].first_setting = checked_index(settings.size());
+        sections[index].number_of_settings = checked_index(source_settings.size());
+        for (const auto* entry : source_settings)
+        {
+            // A published tree is not modified (see config_handle): its values are formatted in a copy.
+            std::string_view value = entry->second;
+            if (mode == Formatted_values)
+            {
+                std::string formatted_value = source.formatted_value_copy_(entry->second, &root);
+                if (formatted_value != value)
+                    value = formatted_values.emplace_back(std::move(formatted_value));
+            }
+            settings.push_back(setting_node{ pool_string(entry->first), pool_string(value) });
+        }
+
+        std::vector<const section::sections_dictionnary::value_type*> source_subsections;
+        source_subsections.reserve(source.sections_.size());
+        for (const auto& entry : source.sections_)
+            source_subsections.push_back(&entry);
+        std::sort(source_subsections.begin(), source_subsections.end(),
+                  [](const auto* lhs, const auto* rhs) { return name_less(lhs->first, rhs->first); });
+        sections[index].first_section = checked_index(sections.size());
+        sections[index].number_of_sections = checked_index(source_subsections.size());
+        for (const auto* entry : source_subsections)
+        {
+            section_node& node = sections.emplace_back();
+            node.name = pool_string(entry->first);
+            node.parent = checked_index(index);
+            source_sections.push_back(entry->second.get());
+        }
+    }
+
+    const std::size_t sections_size = sections.size() * sizeof(section_node);
+    const std::size_t settings_size = settings.size() * sizeof(setting_node);
+    image_buffer_.resize(sizeof(image_header) + sections_size + settings_size + string_pool.size());
+    char* image = image_buffer_.data();
+    // The empty parts are not copied: the data of an empty vector can be null, which memcpy() does not accept.
+    if (sections_size != 0)
+        std::memcpy(image + sizeof(image_header), sections.data(), sections_size);
+    if (settings_size != 0)
+        std::memcpy(image + sizeof(image_header) + sections_size, settings.data(), settings_size);
+    if (!string_pool.empty())
+        std::memcpy(image + sizeof(image_header) + sections_size + settings_size, string_pool.data(),
+                    string_pool.size());
+    image_header header;
+    std::memcpy(header.magic, image_magic, sizeof(image_magic));
+    header.version = binary_version;
+    header.byte_order_mark = image_byte_order_mark;
+    header.number_of_sections = checked_index(sections.size());
+    header.number_of_settings = checked_index(settings.size());
+    header.string_pool_size = checked_index(string_pool.size());
+    header.reserved = 0;
+    header.checksum = fnv1a_hash(std::string_view(image_buffer_).substr(sizeof(image_header)));
+    std::memcpy(image, &header, sizeof(image_header));
+    set_image_(image_buffer_);
+}
+
+frozen_config::frozen_config(frozen_config&& other) noexcept
+    : image_buffer_(std::move(other.image_buffer_)), image_file_(std::move(other.image_file_)),
+      image_(std::exchange(other.image_, std::string_view())), sections_(std::exchange(other.sections_, nullptr)),
+      settings_(std::exchange(other.settings_, nullptr)), string_pool_(std::exchange(other.string_pool_, nullptr))
+{
+}
+
+frozen_config& frozen_config::operator=(frozen_config&& other) noexcept
+{
+    if (this != &other)
+    {
+        image_buffer_ = std::move(other.image_buffer_);
+        image_file_ = std::move(other.image_file_);
+        image_ = std::exchange(other.image_, std::string_view());
+        sections_ = std::exchange(other.sections_, nullptr);
+        settings_ = std::exchange(other.settings_, nullptr);
+        string_pool_ = std::exchange(other.string_pool_, nullptr);
+    }
+    return *this;
+}
+
+void frozen_config::write_binary(std::ostream& stream) const
+{
+    stream.write(image_.data(), static_cast<std::streamsize>(image_.size()));
+}
+
+void frozen_config::write_binary(const std::filesystem::path& path) const
+{
+    // The file is replaced, not truncated: it may be the mapped image of another frozen_config.
+    atomic_file_writer writer(path, false);
+    writer.write(image_);
+    writer.commit();
+}
+
+frozen_config frozen_config::read_binary(const std::filesystem::path& path, bool verify_checksum)
+{
+    return frozen_config(mapped_file(path), verify_checksum);
+}
+
+frozen_config::frozen_config(mapped_file image_file, bool verify_checksum) : image_file_(std::move(image_file))
+{
+    std::string_view image = image_file_.view();
+    if (image.size() < sizeof(image_header))
+        throw_invalid_image("the image is truncated.");
+    if (reinterpret_cast<std::uintptr_t>(image.data()) % alignof(image_header) != 0)
+        throw_invalid_image("the image is not aligned.");
+    const image_header& header = *reinterpret_cast<const image_header*>(image.data());
+    if (std::memcmp(header.magic, image_magic, sizeof(image_magic)) != 0)
+        throw_invalid_image("bad magic number.");
+    if (header.byte_order_mark != image_byte_order_mark)
+        throw_invalid_image("the byte order is not the one of this machine.");
+    if (header.version != binary_version)
+        throw_invalid_image("unsupported version.");
+    if (header.number_of_sections == 0
+        || image.size() != sizeof(image_header) + std::size_t(header.number_of_sections) * sizeof(section_node)
+                               + std::size_t(header.number_of_settings) * sizeof(setting_node)
+                               + header.string_pool_size)
+        throw_invalid_image("the image size is incorrect.");
+    if (verify_checksum && header.checksum != fnv1a_hash(image.substr(sizeof(image_header))))
+        throw_invalid_image("the checksum is incorrect.");
+    set_image_(image);
+    validate_nodes_();
+}
+
+void frozen_config::set_image_(std::string_view image)
+{
+    image_ = image;
+    const image_header& header = header_();
+    sections_ = reinterpret_cast<const section_node*>(image.data() + sizeof(image_header));
+    settings_ = reinterpret_cast<const setting_node*>(sections_ + header.number_of_sections);
+    string_pool_ = reinterpret_cast<const char*>(settings_ + header.number_of_settings);
+}
+
+void frozen_config::validate_nodes_() const
+{
+    // The lookups only follow the ranges of the nodes: an image whose ranges are in its arrays and in its string pool
+    // is safe to read, whatever its content (which is only verified by the checksum).
+    const image_header& header = header_();
+    auto is_in_range = [](std::uint32_t first, std::uint32_t count, std::uint32_t size)
+    { return std::uint64_t(first) + count <= size; };
+    auto is_in_pool = [&](const string_ref& ref)
+    { return is_in_range(ref.offset, ref.length, header.string_pool_size); };
+    for (const section_node& node : std::span(sections_, header.number_of_sections))
+    {
+        if (!is_in_pool(node.name) || node.parent >= header.number_of_sections
+            || !is_in_range(node.first_section, node.number_of_sections, header.number_of_sections)
+            || !is_in_range(node.first_setting, node.number_of_settings, header.number_of_settings))
+            throw_invalid_image("a section node is out of the image.");
+    }
+    for (const setting_node& node : std::span(settings_, header.number_of_settings))
+    {
+        if (!is_in_pool(node.name) || !is_in_pool(node.value))
+            throw_invalid_image("a setting node is out of the image.");
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool frozen_config::section_view::has_subsection(std::string_view section_path) const
+{
+    return find_section_(section_path) != nullptr;
+}
+
+frozen_config::section_view frozen_config::section_view::subsection(std::string_view section_path) const
+{
+    const section_node* node = find_section_(section_path);
+    if (!node)
+        throw std::runtime_error(std::string("The section does not exist: ") += section_path);
+    return section_view(config_, static_cast<std::uint32_t>(node - config_->sections_));
+}
+
+bool frozen_config::section_view::has_setting(std::string_view setting_path) const
+{
+    return find_setting_(setting_path) != nullptr;
+}
+
+const frozen_config::section_node* frozen_config::section_view::find_section_(std::string_view section_path) const
+{
+    const section_node* node = &node_();
+    if (section_path.empty())
+        return node;
+    for (;;)
+    {
+        std::size_t dot_index = section_path.find('.');
+        std::string_view section_name = section_path.substr(0, dot_index);
+        node = find_node(config_->sections_ + node->first_section, node->number_of_sections, section_name,
+                         config_->string_pool_);
+        if (!node || dot_index == std::string_view::npos)
+            return node;
+        section_path.remove_prefix(dot_index + 1);
+    }
+}
+
+const frozen_config::setting_node* frozen_config::section_view::find_setting_(std::string_view setting_path) const
+{
+    const section_node* node = &node_();
+    std::size_t dot_index = setting_path.rfind('.');
+    if (dot_index != std::string_view::npos)
+    {
+        node = find_section_(setting_path.substr(0, dot_index));
+        if (!node)
+            return nullptr;
+        setting_path.remove_prefix(dot_index + 1);
+    }
+    return find_node(config_->settings_ + node->first_setting, node->number_of_settings, setting_path,
+                     config_->string_pool_);
+}
+
+} // namespace inis
+} // namespace arba
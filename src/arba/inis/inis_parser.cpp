@@ -1,9 +1,16 @@
 #include <arba/inis/inis.hpp>
+#include <arba/inis/instrumentation.hpp>
+#include <arba/inis/mapped_file.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
 #include <iostream>
-#include <regex>
+#include <mutex>
+#include <stdexcept>
 #include <string_view>
+#include <thread>
 
 inline namespace arba
 {
@@ -14,7 +21,7 @@ using namespace std::literals::string_literals;
 
 section::parser::parser(section* section, const std::string_view& comment_marker)
     : this_section_(section), comment_marker_(comment_marker), current_section_(nullptr), current_value_(nullptr),
-      current_value_category_(Single_line)
+      typed_value_cache_enabled_(false), current_value_category_(Single_line)
 {
 }
 
@@ -22,27 +29,147 @@ section::parser::parser(section* section) : parser(section, std::string_view("//
 {
 }
 
+// A file read because of an include directive, with its lines and the canonical paths of the files it includes.
+struct section::parser::included_file
+{
+    mapped_file content;
+    std::vector<line_delimiters> lines;
+    std::vector<std::string> includes;
+    std::exception_ptr error;
+};
+
+struct section::parser::included_files
+{
+    std::unordered_map<std::string, std::unique_ptr<included_file>> files;
+};
+
+section::parser::~parser() = default;
+
 void section::parser::parse(std::istream& stream)
 {
+    ARBA_INIS_SPAN("inis.parse");
+    ARBA_INIS_COUNT(operations, 1);
+    include_stack_.clear();
     read_from_stream_(stream);
+    end_read_();
 }
 
 void section::parser::parse(const std::filesystem::path& setting_filepath)
 {
-    this_section_->settings_.insert_or_assign(
-        std::string(settings_dir), std::filesystem::canonical(setting_filepath).parent_path().generic_string());
-    std::ifstream stream(setting_filepath);
-    read_from_stream_(stream);
+    ARBA_INIS_SPAN("inis.parse");
+    ARBA_INIS_COUNT(operations, 1);
+    const std::filesystem::path canonical_path = std::filesystem::canonical(setting_filepath);
+    this_section_->assign_setting_(settings_dir, canonical_path.parent_path().generic_string());
+    // The file is stated before it is mapped: a later modification of the file is detected by write_to_file().
+    recording_source_spans_ = this_section_->is_root() && this_section_->is_source_spans_enabled();
+    if (recording_source_spans_)
+        this_section_->start_source_spans_(canonical_path);
+    mapped_file file(setting_filepath);
+    source_begin_ = file.data();
+    include_stack_.assign(1, canonical_path.generic_string());
+    read_from_buffer_(file.view());
+    end_read_();
+}
+
+void section::parser::parse(std::string_view buffer)
+{
+    ARBA_INIS_SPAN("inis.parse");
+    ARBA_INIS_COUNT(operations, 1);
+    include_stack_.clear();
+    read_from_buffer_(buffer);
+    end_read_();
+}
+
+std::vector<std::string> section::parser::included_paths() const
+{
+    // The included files are only kept until the end of a parse which succeeds.
+    if (!included_files_)
+        return included_paths_;
+    std::vector<std::string> paths;
+    paths.reserve(included_files_->files.size());
+    for (const auto& entry : included_files_->files)
+        paths.push_back(entry.first);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+void section::parser::begin_document()
+{
+    include_stack_.clear();
+    begin_read_();
+}
+
+void section::parser::begin_block(section* sec)
+{
+    current_section_ = sec;
+    reset_current_value_status_();
+}
+
+section::parser::declared_setting section::parser::read_block_line(std::string_view line)
+{
+    declared_setting_ = declared_setting{};
+    ARBA_INIS_COUNT(parsed_lines, 1);
+    read_line_(line);
+    return declared_setting_;
+}
+
+bool section::parser::extract_header_path(const line_delimiters& delimiters, std::string_view& section_path)
+{
+    // Same tests as read_line_(): a line with a '=' (out of the comment) is a setting.
+    std::string_view line = delimiters.line.substr(0, delimiters.comment);
+    if (delimiters.equal < line.length())
+        return false;
+    remove_right_spaces_(line);
+    return extract_section_path_(line, section_path);
+}
+
+bool section::parser::has_include_directive(const line_delimiters& delimiters)
+{
+    std::string_view line = delimiters.line.substr(0, delimiters.comment);
+    remove_right_spaces_(line);
+    std::string_view include_path;
+    return extract_include_path_(line, include_path);
 }
 
 void section::parser::read_from_stream_(std::istream& stream)
+{
+    begin_read_();
+
+    std::string buffer;
+    buffer.reserve(120);
+    while (stream && !stream.eof())
+    {
+        std::getline(stream, buffer);
+        ARBA_INIS_COUNT(parsed_lines, 1);
+        ARBA_INIS_COUNT(scanned_bytes, buffer.size() + !stream.eof());
+        read_line_(buffer);
+    }
+}
+
+void section::parser::read_from_buffer_(std::string_view buffer)
+{
+    begin_read_();
+    // The included files are loaded in parallel before the buffer is read (a stream is read line by line: its
+    // included files are loaded when their include directive is read).
+    if (buffer.find(include_directive) != std::string_view::npos)
+        preload_included_files_(buffer);
+
+    line_scanner scanner(buffer, comment_marker_);
+    ARBA_INIS_COUNT(scanned_bytes, buffer.size());
+    for (line_delimiters delimiters; scanner.next(delimiters);)
+    {
+        ARBA_INIS_COUNT(parsed_lines, 1);
+        read_line_(delimiters);
+    }
+}
+
+void section::parser::begin_read_()
 {
     if (this_section_->is_root())
     {
-        this_section_->settings_.insert_or_assign(
-            std::string(working_dir), std::filesystem::canonical(std::filesystem::current_path()).generic_string());
-        this_section_->settings_.insert_or_assign(std::string(tmp_dir),
-                                                  std::filesystem::temp_directory_path().generic_string());
+        this_section_->assign_setting_(working_dir,
+                                       std::filesystem::canonical(std::filesystem::current_path()).generic_string());
+        this_section_->assign_setting_(tmp_dir, std::filesystem::temp_directory_path().generic_string());
         //        section_->settings_.insert_or_assign("$program_dir"s, "???");
     }
     else
@@ -50,45 +177,269 @@ void section::parser::read_from_stream_(std::istream& stream)
         std::cerr << "WARNING: Load from a section node which is not root." << std::endl;
     }
 
+    if (!recording_source_spans_)
+        this_section_->root().discard_source_spans_();
     current_section_ = this_section_;
     current_value_ = nullptr;
+    included_files_.reset();
+    included_paths_.clear();
+    typed_value_cache_enabled_ = this_section_->is_typed_value_cache_enabled();
+    this_section_->touch_structure_();
+}
 
-    std::string buffer;
-    buffer.reserve(120);
-    while (stream && !stream.eof())
+void section::parser::end_read_()
+{
+    // The values were copied in the tree: the included files can be released.
+    include_stack_.clear();
+    included_paths_ = included_paths();
+    included_files_.reset();
+    if (recording_source_spans_)
+        this_section_->finish_source_spans_();
+    recording_source_spans_ = false;
+    source_begin_ = nullptr;
+}
+
+void section::parser::read_line_(std::string_view line)
+{
+    line_delimiters delimiters;
+    delimiters.line = line;
+    delimiters.equal = line.find('=');
+    delimiters.comment = line.find(comment_marker_);
+    read_line_(delimiters);
+}
+
+void section::parser::read_line_(const line_delimiters& delimiters)
+{
+    std::string_view line = delimiters.line;
+    std::size_t equal_index = delimiters.equal;
+    if (delimiters.comment != line_delimiters::npos)
     {
-        std::getline(stream, buffer);
-        std::string_view line(buffer);
-        remove_comment_(line);
-        remove_right_spaces_(line);
+        line.remove_suffix(line.length() - delimiters.comment);
+        if (equal_index > delimiters.comment)
+            equal_index = line_delimiters::npos;
+    }
+    remove_right_spaces_(line);
+
+    // In a multi-line value, an include directive is a line of the value.
+    if (!current_value_ && try_include_(line))
+        return;
+
+    if (equal_index != line_delimiters::npos && try_create_setting_(line, equal_index))
+        return;
+
+    if (try_create_sections_(line))
+        return;
+
+    if (current_value_)
+    {
+        append_line_to_current_value_(line);
+        return;
+    }
+
+    if (!line.empty())
+        std::cerr << "WARNING: Bad line : '" << line << "'" << std::endl;
+}
+
+bool section::parser::try_include_(const std::string_view& line)
+{
+    std::string_view include_path;
+    if (!extract_include_path_(line, include_path))
+        return false;
+    read_included_file_(resolve_include_path_(include_base_dir_(), include_path));
+    return true;
+}
+
+void section::parser::read_included_file_(const std::string& path)
+{
+    if (std::find(include_stack_.begin(), include_stack_.end(), path) != include_stack_.end())
+        throw std::runtime_error("Cyclic inclusion of the settings file: " + path);
+    if (!included_files_ || !included_files_->files.contains(path))
+        load_included_files_({ path });
+    const included_file& file = *included_files_->files.at(path);
+    if (file.error)
+        std::rethrow_exception(file.error);
 
-        if (try_create_setting_(line))
-            continue;
+    // The included lines are read in the section of the include directive, which is the current section after them.
+    section* including_section = current_section_;
+    reset_current_value_status_();
+    include_stack_.push_back(path);
+    ARBA_INIS_COUNT(scanned_bytes, file.content.size());
+    for (const line_delimiters& delimiters : file.lines)
+    {
+        ARBA_INIS_COUNT(parsed_lines, 1);
+        read_line_(delimiters);
+    }
+    include_stack_.pop_back();
+    current_section_ = including_section;
+    reset_current_value_status_();
+}
+
+void section::parser::preload_included_files_(std::string_view buffer)
+{
+    const std::filesystem::path base_dir = include_base_dir_();
+    std::vector<std::string> paths;
+    line_scanner scanner(buffer, comment_marker_);
+    for (line_delimiters delimiters; scanner.next(delimiters);)
+    {
+        std::string_view line = delimiters.line.substr(0, delimiters.comment);
+        remove_right_spaces_(line);
+        std::string_view include_path;
+        if (extract_include_path_(line, include_path))
+            paths.push_back(resolve_include_path_(base_dir, include_path));
+    }
+    load_included_files_(std::move(paths));
+}
 
-        if (try_create_sections_(line))
-            continue;
+void section::parser::load_included_files_(std::vector<std::string> paths)
+{
+    if (!included_files_)
+        included_files_ = std::make_unique<included_files>();
+    auto& files = included_files_->files;
+    // An empty entry is reserved for each file to load, so that a file included several times is loaded once.
+    std::erase_if(paths, [&files](const std::string& path) { return !files.try_emplace(path).second; });
+    if (paths.empty())
+        return;
 
-        if (current_value_)
+    // Each file is read and split in lines by a worker of the pool, which then queues the files it includes.
+    // A worker stops when no file is queued and no file is being loaded (no more files can be queued). The calling
+    // thread is the first worker, and a new one is started only while there are more files than workers.
+    const unsigned max_number_of_threads =
+        std::clamp(std::thread::hardware_concurrency(), 1u, max_include_loading_threads);
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::size_t number_of_loading_files = 0;
+    std::exception_ptr error;
+    std::vector<std::jthread> workers;
+    std::function<void()> load_files = [&]
+    {
+        std::unique_lock lock(mutex);
+        for (;;)
         {
-            append_line_to_current_value_(line);
-            continue;
+            condition.wait(lock, [&] { return !paths.empty() || number_of_loading_files == 0; });
+            if (paths.empty())
+                return;
+            std::string path = std::move(paths.back());
+            paths.pop_back();
+            ++number_of_loading_files;
+            // The counter is decremented even if an exception is thrown: the other workers would wait forever.
+            try
+            {
+                while (workers.size() + 1 < max_number_of_threads
+                       && workers.size() + 1 < number_of_loading_files + paths.size())
+                    workers.emplace_back(load_files);
+                lock.unlock();
+                std::unique_ptr<included_file> file = load_included_file_(path, comment_marker_);
+                lock.lock();
+                for (const std::string& include : file->includes)
+                {
+                    if (files.try_emplace(include).second)
+                        paths.push_back(include);
+                }
+                files[path] = std::move(file);
+            }
+            catch (...)
+            {
+                if (!lock.owns_lock())
+                    lock.lock();
+                if (!error)
+                    error = std::current_exception();
+            }
+            --number_of_loading_files;
+            condition.notify_all();
         }
+    };
+    load_files();
+    workers.clear(); // joins the workers
 
-        if (!line.empty())
-            std::cerr << "WARNING: Bad line : '" << line << "'" << std::endl;
+    if (error)
+    {
+        // The entries reserved for the files which were not loaded are removed.
+        std::erase_if(files, [](const auto& entry) { return !entry.second; });
+        std::rethrow_exception(error);
+    }
+}
+
+std::unique_ptr<section::parser::included_file> section::parser::load_included_file_(const std::string& path,
+                                                                                     std::string_view comment_marker)
+{
+    auto file = std::make_unique<included_file>();
+    try
+    {
+        file->content = mapped_file(path);
+        const std::filesystem::path base_dir = std::filesystem::path(path).parent_path();
+        line_scanner scanner(file->content.view(), comment_marker);
+        for (line_delimiters delimiters; scanner.next(delimiters);)
+        {
+            file->lines.push_back(delimiters);
+            std::string_view line = delimiters.line.substr(0, delimiters.comment);
+            remove_right_spaces_(line);
+            std::string_view include_path;
+            if (extract_include_path_(line, include_path))
+                file->includes.push_back(resolve_include_path_(base_dir, include_path));
+        }
+    }
+    catch (...)
+    {
+        // The error is raised when the file is included: a file included by a line of a multi-line value is not read.
+        file->error = std::current_exception();
     }
+    return file;
+}
+
+bool section::parser::extract_include_path_(std::string_view line, std::string_view& include_path)
+{
+    // Include directive: '@include' [[:space:]]+ (path | '"' path '"')
+    remove_left_spaces_(line);
+    if (line.length() <= include_directive.length() || !line.starts_with(include_directive)
+        || !is_space_char_(line[include_directive.length()]))
+        return false;
+    std::string_view path = line.substr(include_directive.length());
+    remove_spaces_(path);
+    if (path.length() >= 2 && path.front() == '"' && path.back() == '"')
+        path = path.substr(1, path.length() - 2);
+    if (path.empty())
+        return false;
+    include_path = path;
+    return true;
 }
 
-bool section::parser::try_create_setting_(const std::string_view& line)
+std::string section::parser::resolve_include_path_(const std::filesystem::path& base_dir,
+                                                   std::string_view include_path)
+{
+    std::error_code error;
+    std::filesystem::path path = base_dir / std::filesystem::path(include_path);
+    std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
+    return (error ? path.lexically_normal() : canonical_path).generic_string();
+}
+
+std::filesystem::path section::parser::include_base_dir_() const
+{
+    // The paths are relative to the including file, or to $settings_dir for the included files of a stream or a buffer.
+    if (!include_stack_.empty())
+        return std::filesystem::path(include_stack_.back()).parent_path();
+    auto iter = this_section_->settings_.find(settings_dir);
+    if (iter != this_section_->settings_.end())
+        return std::filesystem::path(std::string_view(iter->second));
+    return std::filesystem::current_path();
+}
+
+bool section::parser::try_create_setting_(const std::string_view& line, std::size_t equal_index)
 {
     std::string_view label;
     std::string_view value;
     std::string_view value_end_marker;
     value_category value_cat = Single_line;
-    if (extract_name_and_value_(line, label, value, value_end_marker, value_cat))
+    if (extract_name_and_value_(line, equal_index, label, value, value_end_marker, value_cat))
     {
-        settings_dictionnary::value_type setting(label, value);
-        auto insert_res = current_section_->settings_.emplace(std::move(setting));
+        auto insert_res = current_section_->emplace_setting_(label, value);
+        if (insert_res.second && typed_value_cache_enabled_)
+            insert_res.first->second.enable_cache_(true);
+        // The settings of the included files are not declared by the line being read (see read_block_line()).
+        if (insert_res.second && include_stack_.empty())
+            declared_setting_ = declared_setting{ label, value, &insert_res.first->second };
+        // Only the values of the read file are recorded (the lines of its included files are not in its buffer).
+        if (recording_source_spans_ && insert_res.second && value_cat == Single_line && include_stack_.size() == 1)
+            this_section_->add_source_span_(&insert_res.first->second, value.data() - source_begin_, value.length());
         current_value_category_ = value_cat;
         if (value_cat != Single_line)
         {
@@ -104,13 +455,9 @@ bool section::parser::try_create_setting_(const std::string_view& line)
 
 bool section::parser::try_create_sections_(const std::string_view& line)
 {
-    std::match_results<std::string_view::const_iterator> match;
-    if (std::regex_match(line.begin(), line.end(), match,
-                         std::regex(R"(^\[([\._[:alnum:]]+)\]$)"s, std::regex_constants::ECMAScript)))
+    std::string_view section_path;
+    if (extract_section_path_(line, section_path))
     {
-        const auto& sm = match[1];
-        std::string_view section_path = std::string_view(sm.first, sm.length());
-
         section* sec = current_section_ ? current_section_ : this_section_;
         std::string_view explicit_path = section_path;
         resolve_implicit_path_part_(explicit_path, sec, this_section_);
@@ -125,6 +472,18 @@ bool section::parser::try_create_sections_(const std::string_view& line)
     return false;
 }
 
+bool section::parser::extract_section_path_(const std::string_view& line, std::string_view& section_path)
+{
+    // Section header: '[' [._[:alnum:]]+ ']'
+    if (line.length() < 3 || line.front() != '[' || line.back() != ']')
+        return false;
+    std::string_view path = line.substr(1, line.length() - 2);
+    if (!is_label_(path))
+        return false;
+    section_path = path;
+    return true;
+}
+
 void section::parser::append_line_to_current_value_(const std::string_view& line)
 {
     if (line != current_value_end_marker_)
@@ -135,7 +494,7 @@ void section::parser::append_line_to_current_value_(const std::string_view& line
             {
             case Multi_line:
                 current_value_->reserve(current_value_->length() + line.length() + 1);
-                current_value_->append(1, '\n');
+                current_value_->push_back('\n');
                 break;
             case Split_line:
                 current_value_->reserve(current_value_->length() + line.length());
@@ -161,15 +520,15 @@ void section::parser::reset_current_value_status_()
     current_value_end_marker_.clear();
 }
 
-bool section::parser::extract_name_and_value_(std::string_view str, std::string_view& label, std::string_view& value,
-                                              std::string_view& value_end_marker, value_category& value_cat)
+bool section::parser::extract_name_and_value_(std::string_view str, std::size_t equal_index, std::string_view& label,
+                                              std::string_view& value, std::string_view& value_end_marker,
+                                              value_category& value_cat)
 {
-    std::size_t index = str.find('=');
-    if (index != std::string::npos)
+    if (equal_index < str.length())
     {
-        label = str.substr(0, index);
+        label = str.substr(0, equal_index);
         remove_spaces_(label);
-        value = str.substr(index + 1);
+        value = str.substr(equal_index + 1);
 
         if (!value.empty())
         {
@@ -195,13 +554,6 @@ bool section::parser::extract_name_and_value_(std::string_view str, std::string_
     return false;
 }
 
-void section::parser::remove_comment_(std::string_view& str)
-{
-    std::size_t index = str.find(comment_marker_);
-    if (index != std::string::npos)
-        str.remove_suffix(str.length() - index);
-}
-
 void section::parser::remove_spaces_(std::string_view& str)
 {
     remove_right_spaces_(str);
@@ -210,14 +562,14 @@ void section::parser::remove_spaces_(std::string_view& str)
 
 void section::parser::remove_left_spaces_(std::string_view& str)
 {
-    auto iter = std::find_if(str.begin(), str.end(), std::not_fn(isspace));
+    auto iter = std::find_if_not(str.begin(), str.end(), &is_space_char_);
     if (iter != str.end())
         str.remove_prefix(iter - str.begin());
 }
 
 void section::parser::remove_right_spaces_(std::string_view& str)
 {
-    auto riter = std::find_if(str.rbegin(), str.rend(), std::not_fn(isspace));
+    auto riter = std::find_if_not(str.rbegin(), str.rend(), &is_space_char_);
     if (riter != str.rend())
         str.remove_suffix(str.end() - riter.base());
 }
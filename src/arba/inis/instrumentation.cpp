@@ -0,0 +1,200 @@
+#include <arba/inis/instrumentation.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+inline namespace arba
+{
+namespace inis
+{
+namespace instrumentation
+{
+
+namespace
+{
+
+inline constexpr bool is_max_counter(std::size_t counter_index)
+{
+    return counter_index == static_cast<std::size_t>(counter::max_format_depth);
+}
+
+struct thread_counters;
+
+struct counters_registry
+{
+    std::mutex mutex;
+    std::vector<thread_counters*> threads;
+    // counters of the terminated threads:
+    std::array<std::uint64_t, number_of_counters> retired_values{};
+};
+
+counters_registry& registry()
+{
+    // Never destroyed: the counters of the threads terminated during the exit of the program still need it.
+    static counters_registry* instance = new counters_registry();
+    return *instance;
+}
+
+// Only the thread of the counters modifies them: relaxed loads and stores are enough, and cost as much as plain ones.
+struct thread_counters
+{
+    std::array<std::atomic<std::uint64_t>, number_of_counters> values{};
+    std::array<std::uint64_t, number_of_counters> depths{};
+
+    thread_counters()
+    {
+        std::lock_guard lock(registry().mutex);
+        registry().threads.push_back(this);
+    }
+
+    ~thread_counters()
+    {
+        counters_registry& counters = registry();
+        std::lock_guard lock(counters.mutex);
+        for (std::size_t index = 0; index < number_of_counters; ++index)
+        {
+            const std::uint64_t value = values[index].load(std::memory_order_relaxed);
+            std::uint64_t& retired_value = counters.retired_values[index];
+            retired_value = is_max_counter(index) ? std::max(retired_value, value) : retired_value + value;
+        }
+        std::erase(counters.threads, this);
+    }
+};
+
+thread_counters& local_counters()
+{
+    thread_local thread_counters counters;
+    return counters;
+}
+
+std::atomic<span_hook> current_span_hook = nullptr;
+std::atomic<void*> current_span_user_data = nullptr;
+
+class counting_resource : public std::pmr::memory_resource
+{
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        add(counter::tree_allocations, 1);
+        add(counter::tree_allocated_bytes, bytes);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+} // namespace
+
+statistics current_statistics()
+{
+    std::array<std::uint64_t, number_of_counters> values;
+    {
+        counters_registry& counters = registry();
+        std::lock_guard lock(counters.mutex);
+        values = counters.retired_values;
+        for (const thread_counters* thread : counters.threads)
+        {
+            for (std::size_t index = 0; index < number_of_counters; ++index)
+            {
+                const std::uint64_t value = thread->values[index].load(std::memory_order_relaxed);
+                values[index] = is_max_counter(index) ? std::max(values[index], value) : values[index] + value;
+            }
+        }
+    }
+    auto value_of = [&values](counter counter_id) { return values[static_cast<std::size_t>(counter_id)]; };
+    statistics stats;
+    stats.parsed_lines = value_of(counter::parsed_lines);
+    stats.scanned_bytes = value_of(counter::scanned_bytes);
+    stats.lookups = value_of(counter::lookups);
+    stats.lookup_path_depth = value_of(counter::lookup_path_depth);
+    stats.format_expansions = value_of(counter::format_expansions);
+    stats.max_format_depth = value_of(counter::max_format_depth);
+    stats.tree_allocations = value_of(counter::tree_allocations);
+    stats.tree_allocated_bytes = value_of(counter::tree_allocated_bytes);
+    stats.operations = value_of(counter::operations);
+    return stats;
+}
+
+void reset_statistics()
+{
+    counters_registry& counters = registry();
+    std::lock_guard lock(counters.mutex);
+    counters.retired_values.fill(0);
+    for (thread_counters* thread : counters.threads)
+    {
+        for (std::atomic<std::uint64_t>& value : thread->values)
+            value.store(0, std::memory_order_relaxed);
+    }
+}
+
+void add(counter counter_id, std::uint64_t value)
+{
+    std::atomic<std::uint64_t>& counter_value = local_counters().values[static_cast<std::size_t>(counter_id)];
+    counter_value.store(counter_value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void update_max(counter counter_id, std::uint64_t value)
+{
+    std::atomic<std::uint64_t>& counter_value = local_counters().values[static_cast<std::size_t>(counter_id)];
+    if (value > counter_value.load(std::memory_order_relaxed))
+        counter_value.store(value, std::memory_order_relaxed);
+}
+
+depth_scope::depth_scope(counter max_counter_id) : max_counter_id_(max_counter_id)
+{
+    const std::uint64_t depth = ++local_counters().depths[static_cast<std::size_t>(max_counter_id_)];
+    update_max(max_counter_id_, depth);
+}
+
+depth_scope::~depth_scope()
+{
+    --local_counters().depths[static_cast<std::size_t>(max_counter_id_)];
+}
+
+void update_max_depth(counter max_counter_id, std::uint64_t nested_depth)
+{
+    update_max(max_counter_id, local_counters().depths[static_cast<std::size_t>(max_counter_id)] + nested_depth);
+}
+
+std::pmr::memory_resource* tree_resource()
+{
+    if constexpr (enabled)
+    {
+        // Never destroyed: the sections destroyed during the exit of the program still deallocate their nodes.
+        static counting_resource* resource = new counting_resource();
+        return resource;
+    }
+    return std::pmr::get_default_resource();
+}
+
+void set_span_hook(span_hook hook, void* user_data)
+{
+    current_span_user_data.store(user_data, std::memory_order_relaxed);
+    current_span_hook.store(hook, std::memory_order_release);
+}
+
+scoped_span::scoped_span(std::string_view name)
+    : name_(name), hook_(current_span_hook.load(std::memory_order_acquire)),
+      user_data_(current_span_user_data.load(std::memory_order_relaxed))
+{
+    if (hook_)
+        start_ = std::chrono::steady_clock::now();
+}
+
+scoped_span::~scoped_span()
+{
+    if (hook_)
+        hook_(name_, start_, std::chrono::steady_clock::now() - start_, user_data_);
+}
+
+} // namespace instrumentation
+} // namespace inis
+} // namespace arba
@@ -0,0 +1,152 @@
+#include <arba/inis/layered_config.hpp>
+
+inline namespace arba
+{
+namespace inis
+{
+
+std::size_t layered_config::push_layer(section&& tree)
+{
+    layers_.push_back(std::make_unique<section>(std::move(tree)));
+    const std::size_t layer_index = layers_.size() - 1;
+    std::string path;
+    index_layer_(layer_index, *layers_.back(), path);
+    return layer_index;
+}
+
+std::size_t layered_config::push_layer_from_file(const std::filesystem::path& path)
+{
+    section tree;
+    tree.read_from_file(path);
+    return push_layer(std::move(tree));
+}
+
+std::vector<std::string> layered_config::replace_layer(std::size_t layer_index, section&& tree)
+{
+    section& layer = *layers_.at(layer_index);
+    std::vector<std::string> changed_paths = layer.changed_setting_paths(tree);
+    // The settings of the old tree must not be referenced by the index anymore, even if they did not change.
+    std::string path;
+    unindex_layer_(layer_index, layer, path);
+    layer = std::move(tree);
+    index_layer_(layer_index, layer, path);
+    // The removed settings may be provided by a lower layer:
+    for (const std::string& changed_path : changed_paths)
+    {
+        if (!find_(changed_path))
+            update_path_(changed_path);
+    }
+    return changed_paths;
+}
+
+section::change_set layered_config::reload_layer_from_file(std::size_t layer_index, const std::filesystem::path& path)
+{
+    section::change_set changes = layers_.at(layer_index)->reload_from_file(path);
+    update_paths_(changes);
+    return changes;
+}
+
+section::change_set layered_config::reload_layer_from_buffer(std::size_t layer_index, std::string_view buffer)
+{
+    section::change_set changes = layers_.at(layer_index)->reload_from_buffer(buffer);
+    update_paths_(changes);
+    return changes;
+}
+
+bool layered_config::set_setting(std::size_t layer_index, std::string_view setting_path, const std::string& value)
+{
+    if (!layers_.at(layer_index)->set_setting(setting_path, value))
+        return false;
+    update_path_(setting_path);
+    return true;
+}
+
+std::size_t layered_config::layer_of(std::string_view setting_path) const
+{
+    const effective_setting* effective = find_(setting_path);
+    return effective ? effective->layer_index : npos;
+}
+
+const setting_value* layered_config::find_in_layer_(const section& layer, std::string_view setting_path)
+{
+    const section* sec = &layer;
+    const std::size_t dot_index = setting_path.rfind('.');
+    if (dot_index != std::string_view::npos)
+    {
+        sec = layer.subsection_ptr(setting_path.substr(0, dot_index));
+        if (!sec)
+            return nullptr;
+        setting_path.remove_prefix(dot_index + 1);
+    }
+    auto iter = sec->settings().find(setting_path);
+    return iter != sec->settings().end() ? &iter->second : nullptr;
+}
+
+void layered_config::index_layer_(std::size_t layer_index, const section& sec, std::string& path)
+{
+    // A layer overrides the settings of the layers below it, not the ones of the layers above it.
+    const std::size_t path_length = path.length();
+    for (const auto& entry : sec.settings_)
+    {
+        path.append(entry.first);
+        auto [iter, is_new] = index_.try_emplace(path, effective_setting{ &entry.second, layer_index });
+        if (!is_new && iter->second.layer_index <= layer_index)
+            iter->second = effective_setting{ &entry.second, layer_index };
+        path.resize(path_length);
+    }
+    for (const auto& entry : sec.sections_)
+    {
+        path.append(entry.first).push_back('.');
+        index_layer_(layer_index, *entry.second, path);
+        path.resize(path_length);
+    }
+}
+
+void layered_config::unindex_layer_(std::size_t layer_index, const section& sec, std::string& path)
+{
+    const std::size_t path_length = path.length();
+    for (const auto& entry : sec.settings_)
+    {
+        path.append(entry.first);
+        auto iter = index_.find(path);
+        if (iter != index_.end() && iter->second.layer_index == layer_index)
+            index_.erase(iter);
+        path.resize(path_length);
+    }
+    for (const auto& entry : sec.sections_)
+    {
+        path.append(entry.first).push_back('.');
+        unindex_layer_(layer_index, *entry.second, path);
+        path.resize(path_length);
+    }
+}
+
+void layered_config::update_path_(std::string_view setting_path)
+{
+    for (std::size_t layer_index = layers_.size(); layer_index-- > 0;)
+    {
+        if (const setting_value* value = find_in_layer_(*layers_[layer_index], setting_path))
+        {
+            auto iter = index_.find(setting_path);
+            if (iter != index_.end())
+                iter->second = effective_setting{ value, layer_index };
+            else
+                index_.emplace(setting_path, effective_setting{ value, layer_index });
+            return;
+        }
+    }
+    if (auto iter = index_.find(setting_path); iter != index_.end())
+        index_.erase(iter);
+}
+
+void layered_config::update_paths_(const section::change_set& changes)
+{
+    for (const auto* paths : { &changes.added, &changes.removed, &changes.modified })
+    {
+        for (const std::string& changed_path : *paths)
+            update_path_(changed_path);
+    }
+}
+
+} // namespace inis
+} // namespace arba
@@ -0,0 +1,237 @@
+#include <arba/inis/line_scanner.hpp>
+
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define ARBA_INIS_X86 1
+#else
+#define ARBA_INIS_X86 0
+#endif
+
+#if ARBA_INIS_X86 && (defined(__GNUC__) || defined(__clang__))
+#define ARBA_INIS_HAS_AVX2_KERNEL 1
+#else
+#define ARBA_INIS_HAS_AVX2_KERNEL 0
+#endif
+
+#if ARBA_INIS_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define ARBA_INIS_HAS_SSE2_KERNEL 1
+#else
+#define ARBA_INIS_HAS_SSE2_KERNEL 0
+#endif
+
+inline namespace arba
+{
+namespace inis
+{
+
+namespace
+{
+
+constexpr std::size_t block_size = line_scanner::block_size;
+
+line_scanner::block_masks scan_block_scalar(const char* block, char marker)
+{
+    line_scanner::block_masks masks{ 0, 0, 0 };
+    for (std::size_t i = 0; i < block_size; ++i)
+    {
+        const std::uint64_t bit = std::uint64_t(1) << i;
+        const char ch = block[i];
+        masks.newline |= ch == '\n' ? bit : 0;
+        masks.equal |= ch == '=' ? bit : 0;
+        masks.marker |= ch == marker ? bit : 0;
+    }
+    return masks;
+}
+
+#if ARBA_INIS_HAS_SSE2_KERNEL
+line_scanner::block_masks scan_block_sse2(const char* block, char marker)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i equal = _mm_set1_epi8('=');
+    const __m128i mark = _mm_set1_epi8(marker);
+    line_scanner::block_masks masks{ 0, 0, 0 };
+    for (std::size_t i = 0; i < block_size; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        masks.newline |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)))) << i;
+        masks.equal |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, equal)))) << i;
+        masks.marker |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, mark)))) << i;
+    }
+    return masks;
+}
+#endif
+
+#if ARBA_INIS_HAS_AVX2_KERNEL
+__attribute__((target("avx2"))) inline std::uint64_t avx2_mask(__m256i low, __m256i high, __m256i pattern)
+{
+    const std::uint64_t low_mask = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+    const std::uint64_t high_mask = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+    return low_mask | (high_mask << 32);
+}
+
+__attribute__((target("avx2"))) line_scanner::block_masks scan_block_avx2(const char* block, char marker)
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    return line_scanner::block_masks{ avx2_mask(low, high, _mm256_set1_epi8('\n')),
+                                      avx2_mask(low, high, _mm256_set1_epi8('=')),
+                                      avx2_mask(low, high, _mm256_set1_epi8(marker)) };
+}
+#endif
+
+line_scanner::scan_block_function scan_block_function_of(scan_kernel kernel)
+{
+    switch (kernel)
+    {
+#if ARBA_INIS_HAS_AVX2_KERNEL
+    case scan_kernel::avx2:
+        return &scan_block_avx2;
+#endif
+#if ARBA_INIS_HAS_SSE2_KERNEL
+    case scan_kernel::sse2:
+        return &scan_block_sse2;
+#endif
+    default:
+        return &scan_block_scalar;
+    }
+}
+
+} // namespace
+
+bool line_scanner::is_supported(scan_kernel kernel)
+{
+    switch (kernel)
+    {
+    case scan_kernel::automatic:
+    case scan_kernel::scalar:
+        return true;
+    case scan_kernel::sse2:
+        return ARBA_INIS_HAS_SSE2_KERNEL;
+    case scan_kernel::avx2:
+#if ARBA_INIS_HAS_AVX2_KERNEL
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+scan_kernel line_scanner::best_kernel()
+{
+    static const scan_kernel kernel = []
+    {
+        if (is_supported(scan_kernel::avx2))
+            return scan_kernel::avx2;
+        if (is_supported(scan_kernel::sse2))
+            return scan_kernel::sse2;
+        return scan_kernel::scalar;
+    }();
+    return kernel;
+}
+
+line_scanner::line_scanner(std::string_view buffer, std::string_view comment_marker, scan_kernel kernel)
+    : buffer_(buffer), comment_marker_(comment_marker),
+      kernel_(kernel == scan_kernel::automatic || !is_supported(kernel) ? best_kernel() : kernel),
+      scan_block_function_(scan_block_function_of(kernel_)), block_offset_(0), line_begin_(0),
+      line_equal_(line_delimiters::npos), line_comment_(comment_marker_.empty() ? 0 : line_delimiters::npos),
+      line_index_(0), line_count_(0), done_(false)
+{
+}
+
+line_scanner::block_masks line_scanner::scan_block_(std::size_t block_offset) const
+{
+    const char marker = comment_marker_.empty() ? '\n' : comment_marker_.front();
+    const std::size_t remaining = buffer_.size() - block_offset;
+    if (remaining >= block_size) [[likely]]
+        return scan_block_function_(buffer_.data() + block_offset, marker);
+
+    // The tail is copied in a padded block, and the bits past the end of the buffer are cleared.
+    char tail[block_size] = {};
+    std::memcpy(tail, buffer_.data() + block_offset, remaining);
+    block_masks masks = scan_block_function_(tail, marker);
+    const std::uint64_t valid_bits = (std::uint64_t(1) << remaining) - 1;
+    masks.newline &= valid_bits;
+    masks.equal &= valid_bits;
+    masks.marker &= valid_bits;
+    return masks;
+}
+
+std::size_t line_scanner::find_comment_(std::uint64_t marker_bits, std::size_t block_offset) const
+{
+    const std::size_t marker_size = comment_marker_.size();
+    for (; marker_bits; marker_bits &= marker_bits - 1)
+    {
+        const std::size_t pos = block_offset + std::countr_zero(marker_bits);
+        if (pos + marker_size <= buffer_.size()
+            && std::memcmp(buffer_.data() + pos, comment_marker_.data(), marker_size) == 0)
+            return pos;
+    }
+    return line_delimiters::npos;
+}
+
+void line_scanner::scan_next_blocks_()
+{
+    // Members are copied in locals, so that the stores in lines_ do not force to reload them.
+    const char* const data = buffer_.data();
+    const std::size_t size = buffer_.size();
+    const bool no_marker = comment_marker_.empty();
+    std::size_t block_offset = block_offset_;
+    std::size_t line_begin = line_begin_;
+    std::size_t line_equal = line_equal_;
+    std::size_t line_comment = line_comment_;
+    std::size_t line_count = 0;
+    auto push_line = [&](std::size_t line_end)
+    {
+        line_delimiters& delimiters = lines_[line_count++];
+        delimiters.line = std::string_view(data + line_begin, line_end - line_begin);
+        delimiters.equal = line_equal != line_delimiters::npos ? line_equal - line_begin : line_delimiters::npos;
+        delimiters.comment = line_comment != line_delimiters::npos ? line_comment - line_begin : line_delimiters::npos;
+        line_begin = line_end + 1;
+        line_equal = line_delimiters::npos;
+        line_comment = no_marker ? line_begin : line_delimiters::npos;
+    };
+
+    while (line_count == 0)
+    {
+        if (block_offset >= size)
+        {
+            // Like std::getline, the text after the last '\n' is the last line, even if it is empty.
+            push_line(size);
+            done_ = true;
+            break;
+        }
+
+        const block_masks masks = scan_block_(block_offset);
+        std::uint64_t unscanned_bits = ~std::uint64_t(0);
+        for (std::uint64_t newline_bits = masks.newline; newline_bits; newline_bits &= newline_bits - 1)
+        {
+            const std::uint64_t newline_bit = newline_bits & -newline_bits;
+            const std::uint64_t line_bits = unscanned_bits & (newline_bit - 1);
+            if (line_equal == line_delimiters::npos && (masks.equal & line_bits))
+                line_equal = block_offset + std::countr_zero(masks.equal & line_bits);
+            if (line_comment == line_delimiters::npos && (masks.marker & line_bits))
+                line_comment = find_comment_(masks.marker & line_bits, block_offset);
+            push_line(block_offset + std::countr_zero(newline_bit));
+            unscanned_bits = ~((newline_bit << 1) - 1);
+        }
+        if (line_equal == line_delimiters::npos && (masks.equal & unscanned_bits))
+            line_equal = block_offset + std::countr_zero(masks.equal & unscanned_bits);
+        if (line_comment == line_delimiters::npos && (masks.marker & unscanned_bits))
+            line_comment = find_comment_(masks.marker & unscanned_bits, block_offset);
+        block_offset += block_size;
+    }
+
+    block_offset_ = block_offset;
+    line_begin_ = line_begin;
+    line_equal_ = line_equal;
+    line_comment_ = line_comment;
+    line_index_ = 0;
+    line_count_ = line_count;
+}
+
+} // namespace inis
+} // namespace arba
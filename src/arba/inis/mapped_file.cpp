@@ -0,0 +1,242 @@
+#include <arba/inis/mapped_file.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ARBA_INIS_HAS_MMAP 1
+#else
+#define ARBA_INIS_HAS_MMAP 0
+#endif
+
+inline namespace arba
+{
+namespace inis
+{
+
+namespace
+{
+
+// Under this size, one read() call is cheaper than mapping and unmapping the file.
+// Above it, the mapping shares the pages of the file: a truncation of the file by another writer while it is mapped
+// raises SIGBUS. The writers of this library replace the files they rewrite (see atomic_file_writer), except the patch
+// mode of section::write_to_file(), which shrinks the file in place.
+constexpr std::size_t min_mapped_file_size = 256 * 1024;
+
+[[noreturn]] void throw_file_error(const char* what, const std::filesystem::path& path, int error)
+{
+    throw std::filesystem::filesystem_error(what, path, std::error_code(error, std::generic_category()));
+}
+
+std::filesystem::path make_temporary_path(const std::filesystem::path& path)
+{
+    static std::atomic<unsigned> temporary_file_counter = 0;
+    std::filesystem::path temporary_path = path;
+    temporary_path += ".tmp.";
+#if ARBA_INIS_HAS_MMAP
+    temporary_path += std::to_string(::getpid()) + ".";
+#endif
+    temporary_path += std::to_string(temporary_file_counter++);
+    return temporary_path;
+}
+
+} // namespace
+
+mapped_file::mapped_file(const std::filesystem::path& path)
+{
+#if ARBA_INIS_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_file_error("Cannot open file", path, errno);
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw_file_error("Cannot stat file", path, error);
+    }
+    size_ = static_cast<std::size_t>(file_stat.st_size);
+    if (size_ < min_mapped_file_size)
+    {
+        // Small files, and files whose size is not known in advance (pipes, procfs), are read until EOF.
+        buffer_.resize(size_ > 0 ? size_ + 1 : 4096);
+        std::size_t read_size = 0;
+        for (;;)
+        {
+            if (read_size == buffer_.size())
+                buffer_.resize(buffer_.size() * 2);
+            ssize_t res = ::read(fd, buffer_.data() + read_size, buffer_.size() - read_size);
+            if (res < 0 && errno == EINTR)
+                continue;
+            if (res <= 0)
+                break;
+            read_size += static_cast<std::size_t>(res);
+        }
+        buffer_.resize(read_size);
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+    else
+    {
+        void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw_file_error("Cannot map file", path, error);
+        }
+        ::madvise(address, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(address);
+        mapped_ = true;
+    }
+    ::close(fd);
+#else
+    std::FILE* file = std::fopen(path.string().c_str(), "rb");
+    if (!file)
+        throw_file_error("Cannot open file", path, errno);
+    std::error_code ec;
+    buffer_.resize(static_cast<std::size_t>(std::filesystem::file_size(path, ec)));
+    std::size_t read_size = std::fread(buffer_.data(), 1, buffer_.size(), file);
+    std::fclose(file);
+    buffer_.resize(read_size);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+      mapped_(std::exchange(other.mapped_, false)), buffer_(std::move(other.buffer_))
+{
+    if (!mapped_)
+        data_ = buffer_.data();
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if (this != &other)
+    {
+        release_();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        mapped_ = std::exchange(other.mapped_, false);
+        buffer_ = std::move(other.buffer_);
+        if (!mapped_)
+            data_ = buffer_.data();
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file()
+{
+    release_();
+}
+
+void mapped_file::release_()
+{
+#if ARBA_INIS_HAS_MMAP
+    if (mapped_)
+        ::munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+}
+
+atomic_file_writer::atomic_file_writer(const std::filesystem::path& path, bool is_synced)
+    : path_(path), temporary_path_(make_temporary_path(path)), is_synced_(is_synced)
+{
+    // The temporary file is in the directory of the file, so that it is renamed on the same file system.
+#if ARBA_INIS_HAS_MMAP
+    fd_ = ::open(temporary_path_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd_ < 0)
+        throw_file_error("Cannot open file", temporary_path_, errno);
+    struct stat file_stat;
+    if (::stat(path_.c_str(), &file_stat) == 0)
+        ::fchmod(fd_, file_stat.st_mode & 07777);
+#else
+    file_ = std::fopen(temporary_path_.string().c_str(), "wb");
+    if (!file_)
+        throw_file_error("Cannot open file", temporary_path_, errno);
+#endif
+}
+
+atomic_file_writer::~atomic_file_writer()
+{
+    abort_();
+}
+
+void atomic_file_writer::write(std::string_view chunk)
+{
+#if ARBA_INIS_HAS_MMAP
+    while (!chunk.empty())
+    {
+        const ssize_t length = ::write(fd_, chunk.data(), chunk.size());
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw_file_error("Cannot write file", temporary_path_, errno);
+        }
+        chunk.remove_prefix(static_cast<std::size_t>(length));
+    }
+#else
+    if (std::fwrite(chunk.data(), 1, chunk.size(), file_) != chunk.size())
+        throw_file_error("Cannot write file", temporary_path_, errno);
+#endif
+}
+
+void atomic_file_writer::commit()
+{
+#if ARBA_INIS_HAS_MMAP
+    if (is_synced_ && ::fsync(fd_) != 0)
+        throw_file_error("Cannot sync file", temporary_path_, errno);
+    const int fd = std::exchange(fd_, -1);
+    if (::close(fd) != 0)
+        throw_file_error("Cannot write file", temporary_path_, errno);
+    if (::rename(temporary_path_.c_str(), path_.c_str()) != 0)
+        throw_file_error("Cannot rename file", path_, errno);
+    // The rename is durable once the directory is synced (best effort: not every file system allows it).
+    const std::filesystem::path dir = path_.parent_path();
+    const int dir_fd = is_synced_ ? ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (dir_fd >= 0)
+    {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+#else
+    std::FILE* file = std::exchange(file_, nullptr);
+    if (std::fflush(file) != 0 || std::fclose(file) != 0)
+        throw_file_error("Cannot write file", temporary_path_, errno);
+    std::filesystem::rename(temporary_path_, path_);
+#endif
+    temporary_path_.clear();
+}
+
+void atomic_file_writer::abort_() noexcept
+{
+#if ARBA_INIS_HAS_MMAP
+    if (fd_ >= 0)
+        ::close(std::exchange(fd_, -1));
+#else
+    if (file_)
+        std::fclose(std::exchange(file_, nullptr));
+#endif
+    if (!temporary_path_.empty())
+    {
+        std::error_code error;
+        std::filesystem::remove(temporary_path_, error);
+    }
+}
+
+} // namespace inis
+} // namespace arba
@@ -1,16 +1,29 @@
 #include <arba/inis/inis.hpp>
+#include <arba/inis/instrumentation.hpp>
+#include <arba/inis/mapped_file.hpp>
 
+#include <atomic>
+#include <exception>
 #include <fstream>
 #include <iostream>
-#include <regex>
+#include <map>
+#include <thread>
+#include <unordered_set>
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#define ARBA_INIS_HAS_POSIX_WRITE 1
+#else
+#define ARBA_INIS_HAS_POSIX_WRITE 0
+#endif
 
 inline namespace arba
 {
 namespace inis
 {
 
-using namespace std::literals::string_literals;
-
 template <class Char = char>
 class Basic_string_tokenizer
 {
@@ -56,14 +69,316 @@ using String_tokenizer = Basic_string_tokenizer<>;
 
 //------------------------------------------------------------------------------
 
-section::section()
+section::section() : section(instrumentation::tree_resource())
+{
+}
+
+section::section(std::string name) : section(std::move(name), instrumentation::tree_resource())
+{
+}
+
+section::section(std::pmr::memory_resource* resource)
+    : settings_(resource), sections_(resource), setting_order_(resource), section_order_(resource)
+{
+}
+
+section::section(std::string name, std::pmr::memory_resource* resource)
+    : name_(std::move(name)), settings_(resource), sections_(resource), setting_order_(resource),
+      section_order_(resource)
+{
+}
+
+section::section(section&& other) noexcept
+    : parent_(other.parent_), structure_generation_(new_structure_generation_()),
+      typed_value_cache_enabled_(other.typed_value_cache_enabled_), name_(std::move(other.name_)),
+      settings_(std::move(other.settings_)), sections_(std::move(other.sections_)),
+      setting_order_(std::move(other.setting_order_)), section_order_(std::move(other.section_order_)),
+      subscriptions_(std::move(other.subscriptions_))
+{
+    for (auto& entry : sections_)
+        entry.second->parent_ = this;
+    // The compiled paths resolved in other must not use the sections which were moved out.
+    other.touch_structure_();
+}
+
+section& section::operator=(section&& other) noexcept
+{
+    if (this != &other)
+    {
+        // The subscriptions move with the tree, like with the move constructor. When other has none, the subscriptions
+        // of this tree are kept and notified of the settings which are changed by the assignment.
+        std::vector<std::string> changed_paths;
+        if (!other.subscriptions_ && has_subscriptions_())
+            changed_paths = changed_setting_paths(other);
+        typed_value_cache_enabled_ = other.typed_value_cache_enabled_;
+        name_ = std::move(other.name_);
+        if (settings_.get_allocator() == other.settings_.get_allocator())
+        {
+            settings_ = std::move(other.settings_);
+            sections_ = std::move(other.sections_);
+            setting_order_ = std::move(other.setting_order_);
+            section_order_ = std::move(other.section_order_);
+        }
+        else
+        {
+            // With different memory resources, the entries are moved to new nodes, in declaration order. The
+            // subsections are rebuilt in the memory resource of this tree too: the ones of other are released with
+            // their memory resource.
+            settings_.clear();
+            sections_.clear();
+            setting_order_.clear();
+            section_order_.clear();
+            for (const auto* entry : other.setting_order_)
+            {
+                setting_value& value = other.settings_.find(entry->first)->second;
+                setting_order_.push_back(&*settings_.emplace(entry->first, std::move(value)).first);
+            }
+            std::pmr::polymorphic_allocator<> allocator(resource());
+            for (const auto* entry : other.section_order_)
+            {
+                std::unique_ptr<section, subsection_deleter> subsection(
+                    allocator.new_object<section>(std::string(), resource()), subsection_deleter{ resource() });
+                *subsection = std::move(*other.sections_.find(entry->first)->second);
+                emplace_section_(entry->first, std::move(subsection));
+            }
+            other.setting_order_.clear();
+            other.section_order_.clear();
+            other.settings_.clear();
+            other.sections_.clear();
+        }
+        for (auto& entry : sections_)
+            entry.second->parent_ = this;
+        if (other.subscriptions_)
+            subscriptions_ = std::move(other.subscriptions_);
+        format_cache_.reset();
+        source_spans_.reset();
+        touch_structure_();
+        other.touch_structure_();
+        if (!changed_paths.empty())
+        {
+            if (std::string path = full_path_(); !path.empty())
+            {
+                path.push_back('.');
+                for (std::string& changed_path : changed_paths)
+                    changed_path.insert(0, path);
+            }
+            notify_changes_(changed_paths);
+        }
+    }
+    return *this;
+}
+
+section::~section() = default;
+
+void section::subsection_deleter::operator()(section* sec) const noexcept
+{
+    std::pmr::polymorphic_allocator<>(resource).delete_object(sec);
+}
+
+std::pair<section::settings_dictionnary::iterator, bool> section::emplace_setting_(std::string_view name,
+                                                                                   std::string_view value)
+{
+    auto result = settings_.emplace(name, value);
+    if (result.second)
+        setting_order_.push_back(&*result.first);
+    return result;
+}
+
+void section::assign_setting_(std::string_view name, std::string value)
+{
+    auto iter = settings_.find(name);
+    if (iter != settings_.end())
+        iter->second = std::move(value);
+    else
+        emplace_setting_(name, std::string_view(value));
+}
+
+void section::erase_setting_(settings_dictionnary::iterator iter)
+{
+    std::erase(setting_order_, &*iter);
+    settings_.erase(iter);
+}
+
+void section::assign_section_(std::string_view name, std::unique_ptr<section, subsection_deleter>&& subsection)
+{
+    auto iter = sections_.find(name);
+    if (iter != sections_.end())
+        iter->second = std::move(subsection);
+    else
+        emplace_section_(name, std::move(subsection));
+}
+
+section::sections_dictionnary::iterator
+section::emplace_section_(std::string_view name, std::unique_ptr<section, subsection_deleter>&& subsection)
+{
+    auto iter = sections_.emplace(name, std::move(subsection)).first;
+    section_order_.push_back(&*iter);
+    return iter;
+}
+
+void section::reorder_like_(const section& other)
+{
+    // The entries of other are looked up by name: the names of its nodes are still valid after a move of its values.
+    // The special settings, which are not merged, are the only entries kept in setting_order_ by the merge.
+    for (const auto* entry : other.setting_order_)
+    {
+        if (entry->first.front() != '$')
+            setting_order_.push_back(&*settings_.find(entry->first));
+    }
+    section_order_.clear();
+    for (const auto* entry : other.section_order_)
+        section_order_.push_back(&*sections_.find(entry->first));
+}
+
+//------------------------------------------------------------------------------
+
+// Positions of the values in the file read by read_from_file(), and the state of the file and of the tree when it was
+// read: the positions are valid while both are unchanged.
+struct section::source_spans
+{
+    struct span
+    {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    std::filesystem::path path; // canonical
+    std::uintmax_t file_size = 0;
+    std::filesystem::file_time_type last_write_time;
+    std::uint64_t structure_generation = 0;
+    bool is_complete = false; // false until the file is entirely read
+    std::unordered_map<const setting_value*, span> spans;
+    // values modified since the file was read or patched:
+    std::unordered_set<const setting_value*> modified_values;
+};
+
+void section::enable_source_spans(bool enable)
+{
+    section& root_section = root();
+    root_section.source_spans_enabled_ = enable;
+    if (!enable)
+        root_section.source_spans_.reset();
+}
+
+void section::start_source_spans_(const std::filesystem::path& canonical_path)
+{
+    source_spans_ = std::make_unique<source_spans>();
+    source_spans_->path = canonical_path;
+    source_spans_->file_size = std::filesystem::file_size(canonical_path);
+    source_spans_->last_write_time = std::filesystem::last_write_time(canonical_path);
+}
+
+void section::add_source_span_(const setting_value* value, std::size_t offset, std::size_t length)
+{
+    source_spans_->spans.emplace(value, source_spans::span{ offset, length });
+}
+
+void section::finish_source_spans_()
+{
+    source_spans_->structure_generation = structure_generation_;
+    source_spans_->is_complete = true;
+}
+
+void section::discard_source_spans_()
 {
+    source_spans_.reset();
 }
 
-section::section(std::string name) : name_(std::move(name))
+void section::note_value_change_(const setting_value* value)
 {
+    // The modification of a value without position cannot be patched.
+    section& root_section = root();
+    if (!root_section.source_spans_)
+        return;
+    if (root_section.source_spans_->spans.contains(value))
+        root_section.source_spans_->modified_values.insert(value);
+    else
+        root_section.source_spans_.reset();
 }
 
+//------------------------------------------------------------------------------
+
+struct section::format_cache
+{
+    // A formatted value depends on the section used as root to resolve absolute references.
+    struct key
+    {
+        const section* root;
+        const setting_value* value;
+
+        bool operator==(const key&) const = default;
+    };
+
+    struct key_hash
+    {
+        inline std::size_t operator()(const key& k) const noexcept
+        {
+            return std::hash<const void*>{}(k.root) ^ (std::hash<const void*>{}(k.value) << 1);
+        }
+    };
+
+    // Only read when the tree is read concurrently (see config_handle).
+    std::uint64_t structure_generation = 0;
+    std::unordered_map<const setting_value*, std::vector<format_part>> templates;
+    std::unordered_map<key, std::string, key_hash> formatted_values;
+    // For each setting, the formatted values which were computed from it:
+    std::unordered_map<const setting_value*, std::vector<key>> dependents;
+
+    void add_dependent(const setting_value* value, const key& dependent)
+    {
+        std::vector<key>& value_dependents = dependents[value];
+        if (std::find(value_dependents.begin(), value_dependents.end(), dependent) == value_dependents.end())
+            value_dependents.push_back(dependent);
+    }
+
+    void clear()
+    {
+        templates.clear();
+        formatted_values.clear();
+        dependents.clear();
+    }
+};
+
+struct section::subscription_registry
+{
+    // Trie over the components of the subscribed paths.
+    struct node
+    {
+        node* parent = nullptr;
+        std::unordered_map<std::string, std::unique_ptr<node>, string_hash, std::equal_to<>> children;
+        std::vector<std::size_t> subscription_ids;
+    };
+
+    struct subscription
+    {
+        node* trie_node;
+        change_callback callback;
+    };
+
+    node trie;
+    std::map<std::size_t, subscription> subscriptions;
+    std::size_t next_subscription_id = 0;
+
+    // Appends the subscriptions matching the path: the ones of the trie nodes along the path.
+    void find_subscriptions(std::string_view path, std::vector<std::size_t>& subscription_ids) const
+    {
+        const node* trie_node = &trie;
+        for (;;)
+        {
+            subscription_ids.insert(subscription_ids.end(), trie_node->subscription_ids.begin(),
+                                    trie_node->subscription_ids.end());
+            if (path.empty())
+                return;
+            const std::size_t dot_index = path.find('.');
+            auto iter = trie_node->children.find(path.substr(0, dot_index));
+            if (iter == trie_node->children.end())
+                return;
+            trie_node = iter->second.get();
+            path = dot_index != std::string_view::npos ? path.substr(dot_index + 1) : std::string_view();
+        }
+    }
+};
+
 section& section::root()
 {
     section* root = this;
@@ -80,267 +395,1367 @@ const section& section::root() const
     return *root;
 }
 
+void section::format(std::string& var) const
+{
+    format_(var, this);
+}
+
 std::string section::formatted_setting(const std::string_view& setting_path, const std::string& default_value) const
 {
     std::string value;
     std::string_view section_path;
     std::string_view setting_label;
     split_setting_path_(setting_path, section_path, setting_label);
-    const section* section = subsection_ptr(std::string(section_path));
+    const section* section = subsection_ptr(section_path);
     if (!section) [[unlikely]]
         return default_value;
-    const setting_value* s_value = section->local_get_setting_value_ptr_(std::string(setting_label));
-    value = s_value ? *s_value : default_value;
+    const setting_value* s_value = section->local_get_setting_value_ptr_(setting_label);
+    if (s_value)
+        return section->formatted_value_copy_(*s_value, this);
+    value = default_value;
     section->format_(value, this);
     return value;
 }
 
-const section* section::subsection_ptr(const std::string& section_path) const
+const section* section::subsection_ptr(const std::string_view& section_path) const
 {
     const section* settings = this;
     String_tokenizer tokenizer(section_path, '.');
     for (String_tokenizer::String_view token; tokenizer.has_token();)
     {
         token = tokenizer.next_token();
-        auto iter = settings->sections_.find(std::string(token));
-        if (iter == sections_.end())
+        auto iter = settings->sections_.find(token);
+        if (iter == settings->sections_.end())
             return nullptr;
         settings = iter->second.get();
     }
     return settings;
 }
 
-section* section::subsection_ptr(const std::string& section_path)
+section* section::subsection_ptr(const std::string_view& section_path)
 {
     section* settings = this;
     String_tokenizer tokenizer(section_path, '.');
     for (String_tokenizer::String_view token; tokenizer.has_token();)
     {
         token = tokenizer.next_token();
-        auto iter = settings->sections_.find(std::string(token));
-        if (iter == sections_.end())
+        auto iter = settings->sections_.find(token);
+        if (iter == settings->sections_.end())
             return nullptr;
         settings = iter->second.get();
     }
     return settings;
 }
 
-const setting_value* section::local_get_setting_value_ptr_(const std::string& setting_name) const
+const setting_value* section::local_get_setting_value_ptr_(const std::string_view& setting_name) const
 {
     auto iter = settings_.find(setting_name);
     return iter != settings_.end() ? &iter->second : nullptr;
 }
 
-const setting_value* section::get_setting_value_ptr_(const std::string& setting_path) const
+const setting_value* section::get_setting_value_ptr_(const std::string_view& setting_path) const
 {
+    ARBA_INIS_COUNT(operations, 1);
+    ARBA_INIS_COUNT(lookups, 1);
+    ARBA_INIS_COUNT(lookup_path_depth, std::count(setting_path.begin(), setting_path.end(), '.') + 1);
     std::size_t index = setting_path.rfind('.');
-    std::string section_name;
-    if (index != std::string::npos && index > 0)
-        section_name = setting_path.substr(0, index);
-
     const section* settings = this;
-    if (!section_name.empty())
-        settings = subsection_ptr(section_name);
+    if (index != std::string_view::npos && index > 0)
+        settings = subsection_ptr(setting_path.substr(0, index));
 
     if (settings)
-    {
-        auto iter = settings->settings_.find(setting_path.substr(index + 1));
-        if (iter != settings->settings_.end())
-            return &iter->second;
-    }
+        return settings->local_get_setting_value_ptr_(setting_path.substr(index + 1));
 
     return nullptr;
 }
 
-setting_value* section::get_setting_value_ptr_(const std::string& setting_path)
+setting_value* section::get_setting_value_ptr_(const std::string_view& setting_path)
 {
-    std::size_t index = setting_path.rfind('.');
-    std::string section_name;
-    if (index != std::string::npos && index > 0)
-        section_name = setting_path.substr(0, index);
+    return const_cast<setting_value*>(std::as_const(*this).get_setting_value_ptr_(setting_path));
+}
 
-    section* settings = this;
-    if (!section_name.empty())
-        settings = subsection_ptr(section_name);
+compiled_path section::compile_path(const std::string_view& setting_path) const
+{
+    return compiled_path(this, std::string(setting_path));
+}
 
-    if (settings)
+const setting_value* section::get_setting_value_ptr_(const compiled_path& setting_path) const
+{
+    if (setting_path.base_ != this) [[unlikely]]
+        return get_setting_value_ptr_(setting_path.path_);
+
+    const std::uint64_t generation = root().structure_generation_;
+    if (setting_path.generation_ != generation)
     {
-        auto iter = settings->settings_.find(setting_path.substr(index + 1));
-        if (iter != settings->settings_.end())
-            return &iter->second;
+        setting_path.value_ = get_setting_value_ptr_(setting_path.path_);
+        setting_path.generation_ = generation;
     }
+    return setting_path.value_;
+}
 
-    return nullptr;
+void section::enable_typed_value_cache(bool enable)
+{
+    section& root_section = root();
+    root_section.typed_value_cache_enabled_ = enable;
+    root_section.enable_typed_value_cache_(enable);
 }
 
-void section::format_(std::string& var, const section* root) const
+void section::enable_typed_value_cache_(bool enable)
 {
-    std::string regex_str = R"((\{()";
-    regex_str += R"(\$)";
-    regex_str += R"(?[\._[:alnum:]]+)\}))";
-    std::regex var_regex(regex_str);
+    for (auto& entry : settings_)
+        entry.second.enable_cache_(enable);
+    for (auto& entry : sections_)
+        entry.second->enable_typed_value_cache_(enable);
+}
+
+void section::touch_structure_()
+{
+    root().structure_generation_ = new_structure_generation_();
+}
 
-    auto reg_iter = std::sregex_iterator(var.begin(), var.end(), var_regex);
-    auto reg_end_iter = std::sregex_iterator();
+std::uint64_t section::new_structure_generation_()
+{
+    static std::atomic<std::uint64_t> next_generation = 0;
+    return next_generation.fetch_add(1, std::memory_order_relaxed);
+}
 
-    std::smatch rmatch;
+void section::format_(std::string& var, const section* root) const
+{
+    ARBA_INIS_COUNT(operations, 1);
+    ARBA_INIS_COUNT(format_expansions, 1);
+    ARBA_INIS_DEPTH_SCOPE(max_format_depth);
+    std::vector<format_part> parts;
+    compile_format_(var, parts);
+    if (parts.size() == 1 && !parts.front().is_reference)
+        return;
     std::string formatted_var;
-    std::string::const_iterator bt_begin = var.begin();
-    for (; reg_iter != reg_end_iter; ++reg_iter)
-    {
-        rmatch = *reg_iter;
-        // get the matching token string
-        auto matching_token = rmatch[1];
-        // append the string token before the matching token to formatted_var
-        formatted_var += std::string(bt_begin, matching_token.first);
-        // set the begin before-token iterator to the end of the matching token
-        bt_begin = matching_token.second;
-
-        // get the setting path from the matching token string
-        std::string setting_path = rmatch[2].str();
-        // get the setting value if it exists among settings
-        std::string new_str_token;
-        if (!(get_setting_value_if_exists_(std::string(setting_path), new_str_token, root)))
-            // if not, the string token to append to formatted_var is the entire matching token string
-            new_str_token = matching_token.str();
-        formatted_var += new_str_token;
-    }
-    // append the remaining string to formatted_var
-    formatted_var += std::string(bt_begin, var.cend());
+    append_formatted_(formatted_var, var, parts, root);
     var = std::move(formatted_var);
 }
 
-bool section::get_setting_value_if_exists_(const std::string& setting_path, std::string& value,
-                                           const section* root) const
+void section::append_formatted_(std::string& output, std::string_view text, const std::vector<format_part>& parts,
+                                const section* root) const
 {
-    const section* sec = this;
-    std::string_view explicit_path = setting_path;
-    resolve_implicit_path_part_(explicit_path, sec, root);
-    std::string_view section_path;
-    std::string_view setting_name;
-    split_setting_path_(explicit_path, section_path, setting_name);
-    sec = sec->subsection_ptr(std::string(section_path));
-
-    const setting_value* s_value = sec->get_setting_value_ptr_(std::string(setting_name));
-    if (s_value)
-    {
-        value = *s_value;
-    }
-    else
+    for (const format_part& part : parts)
     {
-        return false;
+        if (!part.is_reference)
+        {
+            output.append(text.substr(part.offset, part.length));
+            continue;
+        }
+
+        const section* owner = nullptr;
+        const setting_value* s_value = resolve_reference_(text.substr(part.offset, part.length), root, owner);
+        if (s_value)
+        {
+            if (this->root().concurrent_reads_enabled_)
+                owner->append_frozen_formatted_value_(output, *s_value, root);
+            else
+                output.append(owner->formatted_value_(*s_value, root));
+        }
+        else
+        {
+            // An unknown reference is kept as is, braces included.
+            output.append(text.substr(part.offset - 1, part.length + 2));
+        }
     }
+}
 
-    sec->format_(value, root);
-    return true;
+const std::string& section::formatted_value_(const setting_value& value, const section* root) const
+{
+    format_cache& cache = format_cache_of_root_();
+    const format_cache::key key{ root, &value };
+    auto iter = cache.formatted_values.find(key);
+    if (iter != cache.formatted_values.end())
+        return iter->second;
+    std::string formatted_value = format_value_(value, root, &cache);
+    return cache.formatted_values.insert_or_assign(key, std::move(formatted_value)).first->second;
 }
 
-void section::write_to_stream_(std::ostream& stream, const section* const root,
-                               const std::string_view& default_value_end_marker)
+std::string section::formatted_value_copy_(const setting_value& value, const section* root) const
 {
-    if (this != root)
+    if (!this->root().concurrent_reads_enabled_)
+        return formatted_value_(value, root);
+    std::string formatted_value;
+    append_frozen_formatted_value_(formatted_value, value, root);
+    return formatted_value;
+}
+
+void section::append_frozen_formatted_value_(std::string& output, const setting_value& value,
+                                             const section* root) const
+{
+    // The format cache is only read: the values which were not formatted when the tree was frozen are formatted each
+    // time they are read.
+    const format_cache& cache = *this->root().format_cache_;
+    auto iter = cache.formatted_values.find(format_cache::key{ root, &value });
+    if (iter != cache.formatted_values.end())
+        output.append(iter->second);
+    else
+        output.append(format_value_(value, root, nullptr));
+}
+
+std::string section::format_value_(const setting_value& value, const section* root, format_cache* cache) const
+{
+    // A chain of references may be longer than the call stack allows: the references are followed depth first with
+    // an explicit stack, and a value is formatted once the values it references are formatted (in the format cache,
+    // or in a local one if the format cache is frozen).
+    struct formatting_value
     {
-        stream << '[';
-        if (parent_ != root)
-            stream << '.';
-        stream << name() << ']' << std::endl;
-    }
+        const section* owner;
+        const setting_value* value;
+        const std::vector<format_part>* cached_parts; // the template in the format cache, or nullptr
+        std::vector<format_part> parts;
+        std::size_t next_part = 0;
+        std::string formatted_value;
 
-    for (const auto& entry : settings_)
+        inline const std::vector<format_part>& template_parts() const { return cached_parts ? *cached_parts : parts; }
+    };
+
+    ARBA_INIS_DEPTH_SCOPE(max_format_depth);
+    const format_cache& read_cache = cache ? *cache : *this->root().format_cache_;
+    std::unordered_map<const setting_value*, std::string> frozen_formatted_values;
+    std::unordered_set<const setting_value*> formatting_values;
+    std::vector<formatting_value> stack;
+    auto push = [&](const section* owner, const setting_value& s_value)
     {
-        if (entry.first.front() == '$') [[unlikely]]
+        if (!formatting_values.insert(&s_value).second)
+            throw std::runtime_error(std::string("Cyclic reference found while formatting the setting value: ") +=
+                                     s_value);
+        ARBA_INIS_COUNT(operations, 1);
+        ARBA_INIS_COUNT(format_expansions, 1);
+        formatting_value& formatting = stack.emplace_back(formatting_value{ owner, &s_value, nullptr, {}, 0, {} });
+        if (cache)
+        {
+            auto [template_iter, is_new_template] = cache->templates.try_emplace(&s_value);
+            if (is_new_template)
+                compile_format_(s_value, template_iter->second);
+            formatting.cached_parts = &template_iter->second;
+            cache->add_dependent(&s_value, format_cache::key{ root, &s_value });
+        }
+        else
+            compile_format_(s_value, formatting.parts);
+        ARBA_INIS_NESTED_DEPTH(max_format_depth, stack.size() - 1);
+    };
+    auto find_formatted_value = [&](const setting_value* s_value) -> const std::string*
+    {
+        auto iter = read_cache.formatted_values.find(format_cache::key{ root, s_value });
+        if (iter != read_cache.formatted_values.end())
+            return &iter->second;
+        auto frozen_iter = frozen_formatted_values.find(s_value);
+        return frozen_iter != frozen_formatted_values.end() ? &frozen_iter->second : nullptr;
+    };
+
+    push(this, value);
+    for (;;)
+    {
+        formatting_value& formatting = stack.back();
+        const std::vector<format_part>& parts = formatting.template_parts();
+        const std::string_view text = *formatting.value;
+        const section* referenced_owner = nullptr;
+        const setting_value* referenced_value = nullptr;
+        for (; formatting.next_part < parts.size(); ++formatting.next_part)
+        {
+            const format_part& part = parts[formatting.next_part];
+            if (!part.is_reference)
+            {
+                formatting.formatted_value.append(text.substr(part.offset, part.length));
+                continue;
+            }
+
+            const section* owner = nullptr;
+            const setting_value* s_value =
+                formatting.owner->resolve_reference_(text.substr(part.offset, part.length), root, owner);
+            if (!s_value)
+            {
+                // An unknown reference is kept as is, braces included.
+                formatting.formatted_value.append(text.substr(part.offset - 1, part.length + 2));
+                continue;
+            }
+            const std::string* formatted_value = find_formatted_value(s_value);
+            if (!formatted_value)
+            {
+                // The reference is resolved again once the referenced value is formatted.
+                referenced_owner = owner;
+                referenced_value = s_value;
+                break;
+            }
+            formatting.formatted_value.append(*formatted_value);
+            if (cache)
+                cache->add_dependent(s_value, format_cache::key{ root, formatting.value });
+        }
+        if (referenced_value)
+        {
+            push(referenced_owner, *referenced_value);
             continue;
-        stream << entry.first;
-        if (entry.second.find_first_of('\n') == std::string::npos)
-            stream << " = " << entry.second << '\n';
+        }
+
+        if (stack.size() == 1)
+            return std::move(formatting.formatted_value);
+        formatting_values.erase(formatting.value);
+        if (cache)
+            cache->formatted_values.insert_or_assign(format_cache::key{ root, formatting.value },
+                                                     std::move(formatting.formatted_value));
         else
-            stream << " =| " << default_value_end_marker << "\n"
-                   << entry.second << "\n"
-                   << default_value_end_marker << "\n";
+            frozen_formatted_values.emplace(formatting.value, std::move(formatting.formatted_value));
+        stack.pop_back();
     }
-    if (!settings_.empty()) [[unlikely]]
-        stream << '\n';
-
-    for (const auto& entry : sections_)
-        entry.second->write_to_stream_(stream, root, default_value_end_marker);
 }
 
-void section::resolve_implicit_path_part_(std::string_view& path, const section*& sec, const section* root)
+void section::resolve_all()
 {
-    std::size_t offset = 0;
-    const section* lroot = sec;
-    for (auto iter = path.begin(); iter != path.end() && *iter == '.'; ++iter, ++offset)
-    {
-        if (!lroot || lroot == root)
-            throw std::runtime_error(std::string("The section path is incorrect (Too many '.'): ") += path);
-        lroot = lroot->parent();
-    }
-    for (; lroot && lroot != root;)
+    std::vector<std::pair<setting_value*, std::string>> formatted_values;
+    collect_formatted_values_(formatted_values, this);
+    for (auto& [s_value, formatted_value] : formatted_values)
     {
-        lroot = lroot->parent();
-        sec = sec->parent();
+        *s_value = std::move(formatted_value);
+        note_value_change_(s_value);
     }
-    path = path.substr(offset);
+    if (format_cache* cache = root().format_cache_.get())
+        cache->clear();
 }
 
-void section::resolve_implicit_path_part_(std::string_view& path, section*& sec, const section* root)
+void section::collect_formatted_values_(std::vector<std::pair<setting_value*, std::string>>& formatted_values,
+                                        const section* root)
 {
-    std::size_t offset = 0;
-    const section* lroot = sec;
-    for (auto iter = path.begin(); iter != path.end() && *iter == '.'; ++iter, ++offset)
+    for (auto& entry : settings_)
     {
-        if (!lroot || lroot == root)
-            throw std::runtime_error(std::string("The section path is incorrect (Too many '.'): ") += path);
-        lroot = lroot->parent();
+        const std::string& formatted_value = formatted_value_(entry.second, root);
+        if (formatted_value != entry.second)
+            formatted_values.emplace_back(&entry.second, formatted_value);
     }
-    for (; lroot && lroot != root;)
+    for (auto& entry : sections_)
+        entry.second->collect_formatted_values_(formatted_values, root);
+}
+
+const setting_value* section::resolve_reference_(std::string_view reference, const section* root,
+                                                 const section*& owner) const
+{
+    const section* sec = this;
+    resolve_implicit_path_part_(reference, sec, root);
+    std::string_view section_path;
+    std::string_view setting_name;
+    split_setting_path_(reference, section_path, setting_name);
+    sec = sec->subsection_ptr(section_path);
+    if (!sec)
+        return nullptr;
+    owner = sec;
+    return sec->local_get_setting_value_ptr_(setting_name);
+}
+
+section::format_cache& section::format_cache_of_root_() const
+{
+    const section& root_section = root();
+    if (!root_section.format_cache_)
+        root_section.format_cache_ = std::make_unique<format_cache>();
+    format_cache& cache = *root_section.format_cache_;
+    if (cache.structure_generation != root_section.structure_generation_)
     {
-        lroot = lroot->parent();
-        sec = sec->parent();
+        // Adding or removing a setting may change how any reference is resolved.
+        cache.clear();
+        cache.structure_generation = root_section.structure_generation_;
     }
-    path = path.substr(offset);
+    return cache;
+}
+
+void section::enable_concurrent_reads_()
+{
+    // The caches are frozen: the readers never modify the tree. The values with references are formatted from the
+    // root beforehand (the other ones are formatted when they are read, see append_frozen_formatted_value_()).
+    format_cache_of_root_();
+    freeze_formatted_values_(this);
+    enable_typed_value_cache(false);
+    concurrent_reads_enabled_ = true;
 }
 
-bool section::set_setting(const std::string& setting_path, const std::string& value)
+void section::freeze_formatted_values_(const section* root) const
 {
-    std::regex label_regex(R"([\._[:alnum:]]+)"s);
-    if (std::regex_match(setting_path, label_regex))
+    for (const auto& entry : settings_)
     {
-        std::string_view section_path;
-        std::string_view setting_name;
-        split_setting_path_(setting_path, section_path, setting_name);
-        section* sec = subsection_ptr(std::string(section_path));
-        if (sec)
+        if (entry.second.find('{') == std::string::npos)
+            continue;
+        try
         {
-            sec->settings_[setting_path] = value;
-            return true;
+            formatted_value_(entry.second, root);
+        }
+        catch (const std::runtime_error&)
+        {
+            // A cyclic reference: the error is raised when the value is read.
         }
     }
-    return false;
+    for (const auto& entry : sections_)
+        entry.second->freeze_formatted_values_(root);
 }
 
-void section::read_from_stream(std::istream& stream)
+void section::invalidate_formatted_value_(const setting_value* value)
 {
-    parser inis_parser(this);
-    inis_parser.parse(stream);
+    format_cache* cache = root().format_cache_.get();
+    if (!cache)
+        return;
+    cache->templates.erase(value);
+    std::vector<const setting_value*> modified_values{ value };
+    while (!modified_values.empty())
+    {
+        const setting_value* modified_value = modified_values.back();
+        modified_values.pop_back();
+        auto iter = cache->dependents.find(modified_value);
+        if (iter == cache->dependents.end())
+            continue;
+        std::vector<format_cache::key> keys = std::move(iter->second);
+        cache->dependents.erase(iter);
+        for (const format_cache::key& key : keys)
+        {
+            if (cache->formatted_values.erase(key) > 0 && key.value != modified_value)
+                modified_values.push_back(key.value);
+        }
+    }
 }
 
-void section::read_from_file(const std::filesystem::path& path)
+void section::compile_format_(std::string_view text, std::vector<format_part>& parts)
+{
+    // Reference: '{' '$'? [._[:alnum:]]+ '}'
+    parts.clear();
+    std::size_t literal_begin = 0;
+    for (std::size_t index = text.find('{'); index != std::string_view::npos; index = text.find('{', index + 1))
+    {
+        std::size_t reference_begin = index + 1;
+        std::size_t reference_end = reference_begin;
+        if (reference_end < text.length() && text[reference_end] == standard_label_mark_)
+            ++reference_end;
+        const std::size_t label_begin = reference_end;
+        while (reference_end < text.length() && is_label_char_(text[reference_end]))
+            ++reference_end;
+        if (reference_end == label_begin || reference_end == text.length() || text[reference_end] != '}')
+            continue;
+        if (index > literal_begin)
+            parts.push_back(format_part{ literal_begin, index - literal_begin, false });
+        parts.push_back(format_part{ reference_begin, reference_end - reference_begin, true });
+        literal_begin = reference_end + 1;
+        index = reference_end;
+    }
+    if (literal_begin < text.length() || parts.empty())
+        parts.push_back(format_part{ literal_begin, text.length() - literal_begin, false });
+}
+
+// Output of the serializer: the text is appended to a buffer, which is given to the sink one chunk at a time.
+// The buffer of the thread is reused by the next outputs (a nested output, from a sink, uses its own buffer).
+class section::output_buffer
+{
+public:
+    using sink_function = void (*)(void* sink, std::string_view chunk);
+    inline constexpr static std::size_t chunk_size = 64 * 1024;
+
+    output_buffer(sink_function write_chunk, void* sink)
+        : write_chunk_(write_chunk), sink_(sink), reusable_(!reusable_buffer_in_use_),
+          buffer_(reusable_ ? reusable_buffer_ : local_buffer_)
+    {
+        reusable_buffer_in_use_ = true;
+        buffer_.clear();
+        buffer_.reserve(chunk_size);
+    }
+
+    output_buffer(const output_buffer&) = delete;
+    output_buffer& operator=(const output_buffer&) = delete;
+
+    ~output_buffer()
+    {
+        if (reusable_)
+            reusable_buffer_in_use_ = false;
+    }
+
+    inline void append(char ch)
+    {
+        buffer_.push_back(ch);
+        if (buffer_.size() >= chunk_size) [[unlikely]]
+            flush();
+    }
+
+    inline void append(std::string_view text)
+    {
+        if (buffer_.size() + text.size() >= chunk_size) [[unlikely]]
+        {
+            flush();
+            if (text.size() >= chunk_size)
+            {
+                write_chunk_(sink_, text);
+                return;
+            }
+        }
+        buffer_.append(text);
+    }
+
+    void flush()
+    {
+        if (!buffer_.empty())
+        {
+            write_chunk_(sink_, buffer_);
+            buffer_.clear();
+        }
+    }
+
+private:
+    sink_function write_chunk_;
+    void* sink_;
+    bool reusable_;
+    std::string local_buffer_;
+    std::string& buffer_;
+
+    inline static thread_local std::string reusable_buffer_;
+    inline static thread_local bool reusable_buffer_in_use_ = false;
+};
+
+void section::write_to_buffer_(output_buffer& output, const section* const root, std::size_t depth,
+                               const std::string_view& default_value_end_marker) const
+{
+    if (this != root)
+    {
+        // '[' '.'{depth - 1} name ']': the parent is the ancestor of the previous section at depth - 1.
+        output.append('[');
+        for (std::size_t level = 1; level < depth; ++level)
+            output.append('.');
+        output.append(name_);
+        output.append("]\n");
+    }
+
+    for (const auto* entry : setting_order_)
+    {
+        if (entry->first.front() == '$') [[unlikely]]
+            continue;
+        output.append(entry->first);
+        const std::string_view value = entry->second;
+        if (value.find('\n') == std::string_view::npos)
+        {
+            output.append(" = ");
+            output.append(value);
+            output.append('\n');
+        }
+        else
+        {
+            output.append(" =| ");
+            output.append(default_value_end_marker);
+            output.append('\n');
+            output.append(value);
+            output.append('\n');
+            output.append(default_value_end_marker);
+            output.append('\n');
+        }
+    }
+    if (!settings_.empty()) [[unlikely]]
+        output.append('\n');
+
+    for (const auto* entry : section_order_)
+        entry->second->write_to_buffer_(output, root, depth + 1, default_value_end_marker);
+}
+
+void section::resolve_implicit_path_part_(std::string_view& path, const section*& sec, const section* root)
+{
+    std::size_t offset = 0;
+    const section* lroot = sec;
+    for (auto iter = path.begin(); iter != path.end() && *iter == '.'; ++iter, ++offset)
+    {
+        if (!lroot || lroot == root)
+            throw std::runtime_error(std::string("The section path is incorrect (Too many '.'): ") += path);
+        lroot = lroot->parent();
+    }
+    for (; lroot && lroot != root;)
+    {
+        lroot = lroot->parent();
+        sec = sec->parent();
+    }
+    path = path.substr(offset);
+}
+
+void section::resolve_implicit_path_part_(std::string_view& path, section*& sec, const section* root)
+{
+    std::size_t offset = 0;
+    const section* lroot = sec;
+    for (auto iter = path.begin(); iter != path.end() && *iter == '.'; ++iter, ++offset)
+    {
+        if (!lroot || lroot == root)
+            throw std::runtime_error(std::string("The section path is incorrect (Too many '.'): ") += path);
+        lroot = lroot->parent();
+    }
+    for (; lroot && lroot != root;)
+    {
+        lroot = lroot->parent();
+        sec = sec->parent();
+    }
+    path = path.substr(offset);
+}
+
+bool section::set_setting(const std::string_view& setting_path, const std::string& value)
+{
+    ARBA_INIS_COUNT(operations, 1);
+    if (is_label_(setting_path))
+    {
+        std::string_view section_path;
+        std::string_view setting_name;
+        split_setting_path_(setting_path, section_path, setting_name);
+        section* sec = subsection_ptr(section_path);
+        if (sec)
+        {
+            bool is_changed = true;
+            auto iter = sec->settings_.find(setting_name);
+            if (iter != sec->settings_.end())
+            {
+                is_changed = iter->second != value;
+                iter->second = value;
+                invalidate_formatted_value_(&iter->second);
+                if (is_changed)
+                    note_value_change_(&iter->second);
+            }
+            else
+            {
+                auto insert_res = sec->emplace_setting_(setting_name, value);
+                insert_res.first->second.enable_cache_(is_typed_value_cache_enabled());
+                touch_structure_();
+            }
+            if (is_changed && has_subscriptions_())
+            {
+                std::string path = sec->full_path_();
+                if (!path.empty())
+                    path.push_back('.');
+                path.append(setting_name);
+                notify_changes_({ std::move(path) });
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void section::read_from_stream(std::istream& stream)
+{
+    parser inis_parser(this);
+    inis_parser.parse(stream);
+}
+
+void section::read_from_file(const std::filesystem::path& path)
 {
     parser inis_parser(this);
     inis_parser.parse(path);
 }
 
+void section::read_from_buffer(std::string_view buffer)
+{
+    parser inis_parser(this);
+    inis_parser.parse(buffer);
+}
+
+void section::read_from_directory(const std::filesystem::path& dir, const directory_options& options)
+{
+    ARBA_INIS_SPAN("inis.read_from_directory");
+    struct directory_file
+    {
+        std::filesystem::path path;
+        std::string name;
+        std::unique_ptr<section, subsection_deleter> tree;
+        std::exception_ptr error;
+    };
+
+    const std::filesystem::path canonical_dir = std::filesystem::canonical(dir);
+    std::vector<directory_file> files;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(canonical_dir))
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != options.extension)
+            continue;
+        std::string name = entry.path().stem().string();
+        if (!is_label_(name) || name.find('.') != std::string::npos)
+        {
+            std::cerr << "WARNING: The file '" << entry.path().generic_string()
+                      << "' is not read: its name is not a section name." << std::endl;
+            continue;
+        }
+        files.push_back(directory_file{ entry.path(), std::move(name), nullptr, nullptr });
+    }
+    std::sort(files.begin(), files.end(), [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
+
+    // Each file is parsed as the root of its own tree: the trees do not share anything while they are read.
+    const bool typed_value_cache_enabled = is_typed_value_cache_enabled();
+    std::atomic<std::size_t> next_file_index = 0;
+    auto read_files = [&]
+    {
+        for (std::size_t index; (index = next_file_index.fetch_add(1, std::memory_order_relaxed)) < files.size();)
+        {
+            directory_file& file = files[index];
+            try
+            {
+                std::error_code error;
+                const std::uintmax_t file_size = std::filesystem::file_size(file.path, error);
+                const std::size_t initial_size = error ? 1024 : std::max<std::size_t>(file_size, 1024);
+                auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>(initial_size);
+                std::pmr::memory_resource* resource = arena.get();
+                file.tree = std::unique_ptr<section, subsection_deleter>(
+                    std::pmr::polymorphic_allocator<>(resource).new_object<section>(file.name, resource),
+                    subsection_deleter{ resource, std::move(arena) });
+                file.tree->typed_value_cache_enabled_ = typed_value_cache_enabled;
+                file.tree->read_from_file(file.path);
+                for (std::string_view special_setting : { settings_dir, working_dir, tmp_dir })
+                {
+                    if (auto iter = file.tree->settings_.find(special_setting); iter != file.tree->settings_.end())
+                        file.tree->erase_setting_(iter);
+                }
+            }
+            catch (...)
+            {
+                file.error = std::current_exception();
+            }
+        }
+    };
+
+    unsigned number_of_threads = options.number_of_threads;
+    if (number_of_threads == 0)
+        number_of_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    number_of_threads = static_cast<unsigned>(std::min<std::size_t>(number_of_threads, files.size()));
+    {
+        std::vector<std::jthread> workers;
+        if (number_of_threads > 1)
+        {
+            workers.reserve(number_of_threads - 1);
+            for (unsigned index = 1; index < number_of_threads; ++index)
+                workers.emplace_back(read_files);
+        }
+        read_files();
+    }
+
+    auto error_iter = std::find_if(files.begin(), files.end(), [](const auto& file) { return bool(file.error); });
+    if (error_iter != files.end())
+        std::rethrow_exception(error_iter->error);
+
+    section& root_section = root();
+    root_section.discard_source_spans_();
+    if (is_root())
+    {
+        // The settings directory of a tree read from a file is kept.
+        if (!settings_.contains(settings_dir))
+            assign_setting_(settings_dir, canonical_dir.generic_string());
+        assign_setting_(working_dir, std::filesystem::canonical(std::filesystem::current_path()).generic_string());
+        assign_setting_(tmp_dir, std::filesystem::temp_directory_path().generic_string());
+    }
+    for (directory_file& file : files)
+    {
+        file.tree->parent_ = this;
+        assign_section_(file.name, std::move(file.tree));
+    }
+    touch_structure_();
+}
+
+std::size_t section::subscribe(std::string_view path_or_prefix, change_callback callback)
+{
+    section& root_section = root();
+    if (!root_section.subscriptions_)
+        root_section.subscriptions_ = std::make_unique<subscription_registry>();
+    subscription_registry& registry = *root_section.subscriptions_;
+
+    std::string path = full_path_();
+    if (!path.empty() && !path_or_prefix.empty())
+        path.push_back('.');
+    path.append(path_or_prefix);
+    subscription_registry::node* trie_node = &registry.trie;
+    String_tokenizer tokenizer(path, '.');
+    while (!path.empty() && tokenizer.has_token())
+    {
+        std::unique_ptr<subscription_registry::node>& child = trie_node->children[std::string(tokenizer.next_token())];
+        if (!child)
+        {
+            child = std::make_unique<subscription_registry::node>();
+            child->parent = trie_node;
+        }
+        trie_node = child.get();
+    }
+
+    const std::size_t subscription_id = registry.next_subscription_id++;
+    trie_node->subscription_ids.push_back(subscription_id);
+    registry.subscriptions.emplace(subscription_id,
+                                   subscription_registry::subscription{ trie_node, std::move(callback) });
+    return subscription_id;
+}
+
+void section::unsubscribe(std::size_t subscription_id)
+{
+    subscription_registry* registry = root().subscriptions_.get();
+    if (!registry)
+        return;
+    auto iter = registry->subscriptions.find(subscription_id);
+    if (iter == registry->subscriptions.end())
+        return;
+    subscription_registry::node* trie_node = iter->second.trie_node;
+    std::erase(trie_node->subscription_ids, subscription_id);
+    registry->subscriptions.erase(iter);
+    // The nodes left without subscriptions nor children are removed, from the leaf to the root of the trie.
+    while (trie_node->parent && trie_node->subscription_ids.empty() && trie_node->children.empty())
+    {
+        subscription_registry::node* parent = trie_node->parent;
+        std::erase_if(parent->children, [trie_node](const auto& entry) { return entry.second.get() == trie_node; });
+        trie_node = parent;
+    }
+}
+
+std::string section::full_path_() const
+{
+    std::vector<const section*> sections;
+    for (const section* sec = this; !sec->is_root(); sec = sec->parent_)
+        sections.push_back(sec);
+    std::string path;
+    for (auto iter = sections.rbegin(); iter != sections.rend(); ++iter)
+    {
+        if (!path.empty())
+            path.push_back('.');
+        path.append((*iter)->name_);
+    }
+    return path;
+}
+
+bool section::has_subscriptions_() const
+{
+    const subscription_registry* registry = root().subscriptions_.get();
+    return registry && !registry->subscriptions.empty();
+}
+
+void section::notify_changes_(const std::vector<std::string>& changed_paths) const
+{
+    const subscription_registry* registry = root().subscriptions_.get();
+    if (!registry || registry->subscriptions.empty() || changed_paths.empty())
+        return;
+
+    // One batch per subscription, in the subscription order.
+    std::map<std::size_t, std::vector<std::string>> batches;
+    std::vector<std::size_t> subscription_ids;
+    for (const std::string& changed_path : changed_paths)
+    {
+        subscription_ids.clear();
+        registry->find_subscriptions(changed_path, subscription_ids);
+        for (std::size_t subscription_id : subscription_ids)
+            batches[subscription_id].push_back(changed_path);
+    }
+    // The callbacks are copied: a callback may subscribe or unsubscribe.
+    std::vector<std::pair<change_callback, std::vector<std::string>>> calls;
+    calls.reserve(batches.size());
+    for (auto& [subscription_id, paths] : batches)
+        calls.emplace_back(registry->subscriptions.at(subscription_id).callback, std::move(paths));
+    for (const auto& [callback, paths] : calls)
+        callback(paths);
+}
+
+section::change_set section::reload_from_stream(std::istream& stream)
+{
+    section new_tree = make_reloaded_tree_();
+    new_tree.read_from_stream(stream);
+    return merge_reloaded_tree_(new_tree);
+}
+
+section::change_set section::reload_from_file(const std::filesystem::path& path)
+{
+    section new_tree = make_reloaded_tree_();
+    new_tree.read_from_file(path);
+    return merge_reloaded_tree_(new_tree);
+}
+
+section::change_set section::reload_from_buffer(std::string_view buffer)
+{
+    section new_tree = make_reloaded_tree_();
+    new_tree.read_from_buffer(buffer);
+    return merge_reloaded_tree_(new_tree);
+}
+
+section section::make_reloaded_tree_() const
+{
+    // The new tree uses the same memory resource: its subsections can be moved in this tree.
+    section new_tree(name_, resource());
+    new_tree.typed_value_cache_enabled_ = is_typed_value_cache_enabled();
+    return new_tree;
+}
+
+section::change_set section::merge_reloaded_tree_(section& new_tree)
+{
+    ARBA_INIS_SPAN("inis.reload.merge");
+    change_set changes;
+    std::string path;
+    bool is_structure_changed = false;
+    merge_reloaded_section_(new_tree, path, changes, is_structure_changed);
+    root().discard_source_spans_();
+    // An empty section added or removed changes the structure without changing the settings.
+    if (is_structure_changed)
+        touch_structure_();
+    std::sort(changes.added.begin(), changes.added.end());
+    std::sort(changes.removed.begin(), changes.removed.end());
+    std::sort(changes.modified.begin(), changes.modified.end());
+
+    if (has_subscriptions_() && !changes.empty())
+    {
+        std::string path = full_path_();
+        if (!path.empty())
+            path.push_back('.');
+        std::vector<std::string> changed_paths;
+        changed_paths.reserve(changes.added.size() + changes.removed.size() + changes.modified.size());
+        for (const auto* paths : { &changes.added, &changes.removed, &changes.modified })
+        {
+            for (const std::string& changed_path : *paths)
+                changed_paths.push_back(path + changed_path);
+        }
+        notify_changes_(changed_paths);
+    }
+    return changes;
+}
+
+void section::merge_reloaded_section_(section& new_section, std::string& path, change_set& changes,
+                                      bool& is_structure_changed)
+{
+    const std::size_t path_length = path.length();
+    auto changed_path = [&](std::string_view name)
+    {
+        std::string setting_path = path;
+        setting_path.append(name);
+        return setting_path;
+    };
+
+    // The special settings ('$settings_dir', ...) are not settings of the text: the ones set by the read replace the
+    // ones of this tree (the directory of another file), but they are neither removed nor reported.
+    // The other entries of the order are removed before they are erased, and put back by reorder_like_().
+    std::erase_if(setting_order_, [](const auto* entry) { return entry->first.front() != '$'; });
+    for (auto iter = settings_.begin(); iter != settings_.end();)
+    {
+        if (iter->first.front() != '$' && !new_section.settings_.contains(iter->first))
+        {
+            changes.removed.push_back(changed_path(iter->first));
+            iter = settings_.erase(iter);
+            is_structure_changed = true;
+        }
+        else
+            ++iter;
+    }
+    for (auto& entry : new_section.settings_)
+    {
+        auto iter = settings_.find(entry.first);
+        if (entry.first.front() == '$') [[unlikely]]
+        {
+            // A reloaded subsection does not get the special settings of the root of the new tree.
+            if (!is_root())
+                continue;
+            if (iter == settings_.end())
+            {
+                setting_order_.push_back(&*settings_.emplace(entry.first, std::move(entry.second)).first);
+                is_structure_changed = true;
+            }
+            else if (iter->second != entry.second)
+            {
+                iter->second = std::move(entry.second);
+                invalidate_formatted_value_(&iter->second);
+            }
+            continue;
+        }
+        if (iter == settings_.end())
+        {
+            changes.added.push_back(changed_path(entry.first));
+            settings_.emplace(entry.first, std::move(entry.second)); // the order is computed again below
+            is_structure_changed = true;
+        }
+        else if (iter->second != entry.second)
+        {
+            changes.modified.push_back(changed_path(entry.first));
+            iter->second = std::move(entry.second);
+            invalidate_formatted_value_(&iter->second);
+        }
+    }
+
+    for (auto iter = sections_.begin(); iter != sections_.end();)
+    {
+        if (!new_section.sections_.contains(iter->first))
+        {
+            path.append(iter->first).push_back('.');
+            iter->second->collect_setting_paths_(path, changes.removed);
+            path.resize(path_length);
+            iter = sections_.erase(iter);
+            is_structure_changed = true;
+        }
+        else
+            ++iter;
+    }
+    for (auto& entry : new_section.sections_)
+    {
+        path.append(entry.first).push_back('.');
+        auto iter = sections_.find(entry.first);
+        if (iter == sections_.end())
+        {
+            entry.second->collect_setting_paths_(path, changes.added);
+            entry.second->parent_ = this;
+            sections_.emplace(entry.first, std::move(entry.second));
+            is_structure_changed = true;
+        }
+        else
+            iter->second->merge_reloaded_section_(*entry.second, path, changes, is_structure_changed);
+        path.resize(path_length);
+    }
+    reorder_like_(new_section);
+}
+
+void section::collect_setting_paths_(std::string& path, std::vector<std::string>& setting_paths) const
+{
+    const std::size_t path_length = path.length();
+    for (const auto& entry : settings_)
+    {
+        path.append(entry.first);
+        setting_paths.push_back(path);
+        path.resize(path_length);
+    }
+    for (const auto& entry : sections_)
+    {
+        path.append(entry.first).push_back('.');
+        entry.second->collect_setting_paths_(path, setting_paths);
+        path.resize(path_length);
+    }
+}
+
 void section::write_to_stream(std::ostream& stream, std::string_view default_value_end_marker)
 {
-    write_to_stream_(stream, this, default_value_end_marker);
+    ARBA_INIS_SPAN("inis.write");
+    output_buffer output(
+        [](void* sink, std::string_view chunk)
+        { static_cast<std::ostream*>(sink)->write(chunk.data(), static_cast<std::streamsize>(chunk.size())); },
+        &stream);
+    write_to_buffer_(output, this, 0, default_value_end_marker);
+    output.flush();
     stream.flush();
 }
 
-void section::write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker)
+#if ARBA_INIS_HAS_POSIX_WRITE
+namespace
+{
+
+[[noreturn]] void throw_file_error(const char* what, const std::filesystem::path& path)
+{
+    throw std::filesystem::filesystem_error(what, path, std::error_code(errno, std::generic_category()));
+}
+
+struct file_sink
+{
+    int fd;
+    const std::filesystem::path& path;
+};
+
+void write_chunk_to_file(void* sink_ptr, std::string_view chunk)
+{
+    const file_sink& file = *static_cast<const file_sink*>(sink_ptr);
+    while (!chunk.empty())
+    {
+        const ssize_t length = ::write(file.fd, chunk.data(), chunk.size());
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw_file_error("Cannot write file", file.path);
+        }
+        chunk.remove_prefix(static_cast<std::size_t>(length));
+    }
+}
+
+void write_at(int fd, std::string_view text, std::size_t offset, const std::filesystem::path& path)
 {
-    std::ofstream stream(path);
-    write_to_stream(stream, default_value_end_marker);
+    while (!text.empty())
+    {
+        const ssize_t length = ::pwrite(fd, text.data(), text.size(), static_cast<off_t>(offset));
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw_file_error("Cannot write file", path);
+        }
+        text.remove_prefix(static_cast<std::size_t>(length));
+        offset += static_cast<std::size_t>(length);
+    }
+}
+
+} // namespace
+#endif
+
+void section::write_to_file(const std::filesystem::path& path, std::string_view default_value_end_marker,
+                            write_mode mode)
+{
+    ARBA_INIS_SPAN("inis.write");
+    if (mode == write_mode::patch && patch_file_(path))
+        return;
+    // The recorded positions are not valid in a rewritten file.
+    section& root_section = root();
+    std::error_code error;
+    if (root_section.source_spans_ && std::filesystem::equivalent(path, root_section.source_spans_->path, error))
+        root_section.discard_source_spans_();
+    const std::filesystem::file_status status = std::filesystem::symlink_status(path, error);
+    if (mode == write_mode::truncate && std::filesystem::exists(status) && !std::filesystem::is_regular_file(status))
+        write_file_(path, default_value_end_marker);
+    else
+        write_file_atomically_(path, default_value_end_marker, mode != write_mode::truncate);
+}
+
+void section::write_file_(const std::filesystem::path& path, std::string_view default_value_end_marker) const
+{
+#if ARBA_INIS_HAS_POSIX_WRITE
+    file_sink sink{ ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666), path };
+    if (sink.fd < 0)
+        throw_file_error("Cannot open file", path);
+    try
+    {
+        output_buffer output(&write_chunk_to_file, &sink);
+        write_to_buffer_(output, this, 0, default_value_end_marker);
+        output.flush();
+    }
+    catch (...)
+    {
+        ::close(sink.fd);
+        throw;
+    }
+    if (::close(sink.fd) != 0)
+        throw_file_error("Cannot write file", path);
+#else
+    std::ofstream stream(path, std::ios::binary);
+    output_buffer output(
+        [](void* sink, std::string_view chunk)
+        { static_cast<std::ostream*>(sink)->write(chunk.data(), static_cast<std::streamsize>(chunk.size())); },
+        &stream);
+    write_to_buffer_(output, this, 0, default_value_end_marker);
+    output.flush();
+    stream.flush();
+    if (!stream)
+        throw std::filesystem::filesystem_error("Cannot write file", path,
+                                                std::make_error_code(std::errc::io_error));
+#endif
+}
+
+void section::write_file_atomically_(const std::filesystem::path& path, std::string_view default_value_end_marker,
+                                     bool is_synced) const
+{
+    atomic_file_writer writer(path, is_synced);
+    output_buffer output(
+        [](void* sink, std::string_view chunk) { static_cast<atomic_file_writer*>(sink)->write(chunk); }, &writer);
+    write_to_buffer_(output, this, 0, default_value_end_marker);
+    output.flush();
+    writer.commit();
+}
+
+bool section::patch_file_(const std::filesystem::path& path)
+{
+#if ARBA_INIS_HAS_POSIX_WRITE
+    // The positions are valid if the file and the structure of the tree did not change since the file was read.
+    if (!is_root() || !source_spans_ || !source_spans_->is_complete
+        || source_spans_->structure_generation != structure_generation_)
+        return false;
+    std::error_code error;
+    if (std::filesystem::canonical(path, error) != source_spans_->path || error
+        || std::filesystem::file_size(path, error) != source_spans_->file_size || error
+        || std::filesystem::last_write_time(path, error) != source_spans_->last_write_time || error)
+        return false;
+
+    struct value_edit
+    {
+        source_spans::span* span;
+        std::string_view value;
+    };
+    std::vector<value_edit> edits;
+    edits.reserve(source_spans_->modified_values.size());
+    for (const setting_value* value_ptr : source_spans_->modified_values)
+    {
+        const std::string_view value = *value_ptr;
+        // A multi-line value cannot be written at the position of a single-line one.
+        if (value.find('\n') != std::string_view::npos)
+            return false;
+        edits.push_back(value_edit{ &source_spans_->spans.find(value_ptr)->second, value });
+    }
+    if (edits.empty())
+        return true;
+    std::sort(edits.begin(), edits.end(),
+              [](const value_edit& lhs, const value_edit& rhs) { return lhs.span->offset < rhs.span->offset; });
+    // If the length of a value changes, the file is rewritten from the first edited value.
+    const bool is_tail_rewritten = !std::all_of(edits.begin(), edits.end(), [](const value_edit& edit)
+                                                { return edit.span->length == edit.value.length(); });
+    std::string tail;
+    if (is_tail_rewritten)
+    {
+        mapped_file file(path);
+        const std::string_view text = file.view();
+        if (text.size() != source_spans_->file_size)
+            return false;
+        std::size_t offset = edits.front().span->offset;
+        tail.reserve(text.size() - offset);
+        for (const value_edit& edit : edits)
+        {
+            tail.append(text.substr(offset, edit.span->offset - offset)).append(edit.value);
+            offset = edit.span->offset + edit.span->length;
+        }
+        tail.append(text.substr(offset));
+    }
+
+    // From here, the file is modified: the positions are dropped if it fails.
+    std::unique_ptr<source_spans> spans = std::move(source_spans_);
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_file_error("Cannot open file", path);
+    try
+    {
+        if (!is_tail_rewritten)
+        {
+            for (const value_edit& edit : edits)
+                write_at(fd, edit.value, edit.span->offset, path);
+        }
+        else
+        {
+            const std::size_t offset = edits.front().span->offset;
+            write_at(fd, tail, offset, path);
+            if (::ftruncate(fd, static_cast<off_t>(offset + tail.size())) != 0)
+                throw_file_error("Cannot truncate file", path);
+        }
+        if (::fsync(fd) != 0)
+            throw_file_error("Cannot sync file", path);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+    if (::close(fd) != 0)
+        throw_file_error("Cannot write file", path);
+
+    // The positions after an edited value move by the difference of length of the edited values before them.
+    if (is_tail_rewritten)
+    {
+        std::vector<std::pair<std::size_t, std::ptrdiff_t>> shifts; // (end offset of an edit, total shift after it)
+        shifts.reserve(edits.size());
+        std::ptrdiff_t shift = 0;
+        for (const value_edit& edit : edits)
+        {
+            shift += static_cast<std::ptrdiff_t>(edit.value.length()) - static_cast<std::ptrdiff_t>(edit.span->length);
+            shifts.emplace_back(edit.span->offset + edit.span->length, shift);
+        }
+        for (const value_edit& edit : edits)
+            edit.span->length = edit.value.length();
+        for (auto& entry : spans->spans)
+        {
+            source_spans::span& span = entry.second;
+            auto iter = std::upper_bound(shifts.begin(), shifts.end(), span.offset,
+                                         [](std::size_t offset, const auto& edit_shift)
+                                         { return offset < edit_shift.first; });
+            if (iter != shifts.begin())
+                span.offset += std::prev(iter)->second;
+        }
+    }
+    spans->modified_values.clear();
+    spans->file_size = std::filesystem::file_size(path);
+    spans->last_write_time = std::filesystem::last_write_time(path);
+    source_spans_ = std::move(spans);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+section::memory_statistics section::memory_stats() const
+{
+    memory_statistics stats;
+    stats.number_of_sections = 1;
+    stats.node_bytes = sizeof(section);
+    collect_memory_stats_(stats);
+    return stats;
+}
+
+void section::collect_memory_stats_(memory_statistics& stats) const
+{
+    // The characters of a string are out of the string object when they do not fit in its small string buffer.
+    auto heap_bytes = [](const auto& str) -> std::size_t
+    {
+        const char* object = reinterpret_cast<const char*>(&str);
+        const bool is_inline = str.data() >= object && str.data() < object + sizeof(str);
+        return is_inline ? 0 : str.capacity() + 1;
+    };
+    // A node of std::unordered_map holds the value, the pointer to the next node and the hash code.
+    constexpr std::size_t node_overhead = sizeof(void*) + sizeof(std::size_t);
+
+    stats.number_of_settings += settings_.size();
+    stats.key_bytes += heap_bytes(name_);
+    stats.map_bytes += settings_.bucket_count() * sizeof(void*) + sections_.bucket_count() * sizeof(void*);
+    stats.map_bytes += setting_order_.capacity() * sizeof(void*) + section_order_.capacity() * sizeof(void*);
+    stats.node_bytes += settings_.size() * (sizeof(settings_dictionnary::value_type) + node_overhead);
+    stats.node_bytes += sections_.size() * (sizeof(sections_dictionnary::value_type) + node_overhead);
+    for (const auto& entry : settings_)
+    {
+        stats.key_bytes += heap_bytes(entry.first);
+        stats.value_bytes += heap_bytes(entry.second.str());
+        if (entry.second.cache_)
+            stats.value_bytes += sizeof(setting_value::typed_cache);
+    }
+    for (const auto& entry : sections_)
+    {
+        ++stats.number_of_sections;
+        stats.key_bytes += heap_bytes(entry.first);
+        stats.node_bytes += sizeof(section);
+        entry.second->collect_memory_stats_(stats);
+    }
+}
+
+std::vector<std::string> section::changed_setting_paths(const section& other) const
+{
+    std::vector<std::string> changed_paths;
+    std::string path;
+    collect_changed_setting_paths_(this, &other, path, changed_paths);
+    std::sort(changed_paths.begin(), changed_paths.end());
+    return changed_paths;
+}
+
+void section::collect_changed_setting_paths_(const section* before, const section* after, std::string& path,
+                                             std::vector<std::string>& changed_paths)
+{
+    const std::size_t path_length = path.length();
+    auto add_changed_path = [&](std::string_view name)
+    {
+        path.append(name);
+        changed_paths.push_back(path);
+        path.resize(path_length);
+    };
+
+    // One of the sections may be missing: all the settings of the other one are then changed.
+    if (before)
+    {
+        for (const auto& entry : before->settings_)
+        {
+            const setting_value* after_value = after ? after->local_get_setting_value_ptr_(entry.first) : nullptr;
+            if (!after_value || *after_value != entry.second)
+                add_changed_path(entry.first);
+        }
+    }
+    if (after)
+    {
+        for (const auto& entry : after->settings_)
+        {
+            if (!before || !before->local_get_setting_value_ptr_(entry.first))
+                add_changed_path(entry.first);
+        }
+    }
+
+    auto find_subsection = [](const section* sec, std::string_view name) -> const section*
+    {
+        if (!sec)
+            return nullptr;
+        auto iter = sec->sections_.find(name);
+        return iter != sec->sections_.end() ? iter->second.get() : nullptr;
+    };
+    auto visit_subsection = [&](std::string_view name, const section* before_subsection,
+                                const section* after_subsection)
+    {
+        path.append(name);
+        path.push_back('.');
+        collect_changed_setting_paths_(before_subsection, after_subsection, path, changed_paths);
+        path.resize(path_length);
+    };
+    if (before)
+    {
+        for (const auto& entry : before->sections_)
+            visit_subsection(entry.first, entry.second.get(), find_subsection(after, entry.first));
+    }
+    if (after)
+    {
+        for (const auto& entry : after->sections_)
+        {
+            if (!find_subsection(before, entry.first))
+                visit_subsection(entry.first, nullptr, entry.second.get());
+        }
+    }
 }
 
 std::string_view section::parent_section_path_(const std::string_view& path)
@@ -367,12 +1782,20 @@ void section::split_setting_path_(const std::string_view& setting_path, std::str
     }
 }
 
+bool section::is_label_(const std::string_view& str)
+{
+    return !str.empty() && std::all_of(str.begin(), str.end(), &is_label_char_);
+}
+
 section* section::create_sections(const std::string_view& section_path)
 {
-    if (std::regex_match(section_path.begin(), section_path.end(),
-                         std::regex(R"(^([\._[:alnum:]]+)$)"s, std::regex_constants::ECMAScript)))
+    if (is_label_(section_path))
     {
-        return create_sections_(section_path);
+        const std::uint64_t structure_generation = root().structure_generation_;
+        section* leaf_section = create_sections_(section_path);
+        if (root().structure_generation_ != structure_generation && has_subscriptions_())
+            notify_changes_({ leaf_section->full_path_() });
+        return leaf_section;
     }
     return nullptr;
 }
@@ -384,13 +1807,18 @@ section* section::create_sections_(const std::string_view& section_path)
     for (String_tokenizer::String_view token; tokenizer.has_token();)
     {
         token = tokenizer.next_token();
-        auto& settings_uptr = section_ptr->sections_[std::string(token)];
-        if (!settings_uptr)
+        auto iter = section_ptr->sections_.find(token);
+        if (iter == section_ptr->sections_.end())
         {
-            settings_uptr = std::make_unique<section>(std::string(token));
+            std::pmr::polymorphic_allocator<> allocator(section_ptr->resource());
+            std::unique_ptr<section, subsection_deleter> settings_uptr(
+                allocator.new_object<section>(std::string(token), allocator.resource()),
+                subsection_deleter{ allocator.resource() });
             settings_uptr->parent_ = section_ptr;
+            iter = section_ptr->emplace_section_(token, std::move(settings_uptr));
+            touch_structure_();
         }
-        section_ptr = settings_uptr.get();
+        section_ptr = iter->second.get();
     }
 
     return section_ptr;
@@ -0,0 +1,134 @@
+#include <arba/inis/config_handle.hpp>
+#include <arba/inis/frozen_config.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+inis::section make_settings(int version)
+{
+    inis::section settings;
+    settings.read_from_buffer("version = " + std::to_string(version) + R"inis(
+rsc = resource
+[section]
+number = 42
+path = {rsc}/{.number}_{version}
+)inis");
+    return settings;
+}
+
+} // namespace
+
+TEST(config_handle_tests, publish_test)
+{
+    inis::config_handle handle(make_settings(1));
+    ASSERT_EQ(handle.version(), 1);
+    inis::config_handle::snapshot_ptr snapshot = handle.snapshot();
+    ASSERT_EQ(snapshot->setting<int>("version"), 1);
+
+    inis::config_handle::reader reader = handle.make_reader();
+    ASSERT_EQ(reader->setting<int>("section.number"), 42);
+    ASSERT_EQ(reader->formatted_setting("section.path"), "resource/42_1");
+
+    handle.publish(make_settings(2));
+    ASSERT_EQ(handle.version(), 2);
+    // The previous snapshot is still valid:
+    ASSERT_EQ(snapshot->setting<int>("version"), 1);
+    ASSERT_EQ(reader.version(), 1);
+    ASSERT_EQ(reader->setting<int>("version"), 2);
+    ASSERT_EQ(reader.version(), 2);
+    ASSERT_EQ(reader->formatted_setting("section.path"), "resource/42_2");
+
+    inis::section tree = make_settings(3);
+    tree.enable_typed_value_cache();
+    handle.publish(std::move(tree));
+    ASSERT_FALSE(handle.snapshot()->is_typed_value_cache_enabled());
+
+    // The values of a published tree are formatted without modifying it:
+    const inis::frozen_config config(*handle.snapshot(), inis::frozen_config::Formatted_values);
+    ASSERT_EQ(config.setting<std::string>("section.path"), "resource/42_3");
+    std::string text = "{section.path}!";
+    handle.snapshot()->format(text);
+    ASSERT_EQ(text, "resource/42_3!");
+
+    inis::section cyclic_tree;
+    cyclic_tree.read_from_buffer("a = {b}\nb = {a}\nc = {d}\nd = d");
+    handle.publish(std::move(cyclic_tree));
+    ASSERT_THROW(handle.snapshot()->formatted_setting("a"), std::runtime_error);
+    ASSERT_EQ(handle.snapshot()->formatted_setting("c"), "d");
+}
+
+TEST(config_handle_tests, long_reference_chain_test)
+{
+    // The references are resolved from the section used as root: the values of a published tree are formatted from
+    // its root beforehand, and formatted without the format cache from a subsection.
+    constexpr int chain_length = 50000;
+    std::string buffer = "[chain]\n";
+    for (int i = 0; i < chain_length; ++i)
+        buffer += "v" + std::to_string(i) + " = {v" + std::to_string(i + 1) + "}\n";
+    buffer += "v" + std::to_string(chain_length) + " = end\n";
+    inis::section tree;
+    tree.read_from_buffer(buffer);
+    inis::config_handle handle;
+    handle.publish(std::move(tree));
+
+    ASSERT_EQ(handle.snapshot()->formatted_setting("chain.v0"), "{v1}");
+    ASSERT_EQ(handle.snapshot()->subsection("chain").formatted_setting("v0"), "end");
+}
+
+TEST(config_handle_tests, read_from_file_test)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_config_handle_tests.inis";
+    std::ofstream(path) << "number = 7\n";
+    inis::config_handle handle;
+    handle.read_from_file(path);
+    ASSERT_EQ(handle.snapshot()->setting<int>("number"), 7);
+    std::filesystem::remove(path);
+    ASSERT_ANY_THROW(handle.read_from_file(path));
+    ASSERT_EQ(handle.snapshot()->setting<int>("number"), 7);
+}
+
+TEST(config_handle_tests, concurrent_reads_test)
+{
+    constexpr int number_of_versions = 200;
+    inis::config_handle handle(make_settings(0));
+    std::atomic_bool stop = false;
+    std::atomic_int number_of_errors = 0;
+
+    std::vector<std::thread> readers;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        readers.emplace_back(
+            [&]
+            {
+                inis::config_handle::reader reader = handle.make_reader();
+                int last_version = 0;
+                while (!stop.load())
+                {
+                    const inis::section& settings = reader.current();
+                    int version = settings.setting<int>("version");
+                    if (version < last_version || settings.setting<int>("section.number") != 42
+                        || settings.formatted_setting("section.path")
+                               != "resource/42_" + std::to_string(version))
+                        ++number_of_errors;
+                    last_version = version;
+                }
+            });
+    }
+    for (int version = 1; version <= number_of_versions; ++version)
+        handle.publish(make_settings(version));
+    stop = true;
+    for (std::thread& reader : readers)
+        reader.join();
+
+    ASSERT_EQ(number_of_errors.load(), 0);
+    ASSERT_EQ(handle.snapshot()->setting<int>("version"), number_of_versions);
+}
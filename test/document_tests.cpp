@@ -0,0 +1,219 @@
+#include <arba/inis/document.hpp>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+
+constexpr std::string_view document_text = R"inis(// Settings of the application.
+name = app   // the name
+
+[server]
+host = localhost  // where to listen
+port = 80
+
+// Logging:
+[server.log]
+level = info
+[.text]
+body =|EOF
+first line
+second line
+EOF
+footer = end
+)inis";
+
+std::string written_text(const inis::document& doc, std::string_view default_value_end_marker = "")
+{
+    std::ostringstream stream;
+    doc.write_to_stream(stream, default_value_end_marker);
+    return stream.str();
+}
+
+} // namespace
+
+TEST(document_tests, unmodified_round_trip_test)
+{
+    inis::document doc;
+    doc.read_from_buffer(document_text);
+    ASSERT_EQ(doc.number_of_lines(), 17);
+    ASSERT_EQ(doc.number_of_indexed_sections(), 4);
+    ASSERT_EQ(written_text(doc), document_text);
+
+    // Parsing all the sections does not change the written text.
+    ASSERT_EQ(doc.tree().subsection("server").setting<int>("port"), 80);
+    ASSERT_EQ(written_text(doc), document_text);
+}
+
+TEST(document_tests, lazy_parsing_test)
+{
+    inis::document doc;
+    doc.read_from_buffer(document_text);
+    ASSERT_FALSE(doc.is_parsed(""));
+    ASSERT_FALSE(doc.is_parsed("server"));
+
+    ASSERT_EQ(doc.setting<int>("server.port"), 80);
+    ASSERT_TRUE(doc.is_parsed("server"));
+    ASSERT_FALSE(doc.is_parsed("server.log"));
+    ASSERT_FALSE(doc.is_parsed("server.text"));
+    ASSERT_FALSE(doc.is_parsed(""));
+
+    ASSERT_EQ(doc.setting<std::string>("server.text.body"), "first line\nsecond line");
+    ASSERT_EQ(doc.setting<std::string>("server.text.footer"), "end");
+    ASSERT_EQ(doc.setting<std::string>("name"), "app");
+    ASSERT_EQ(doc.setting<std::string>("server.missing", "none"), "none");
+    ASSERT_EQ(doc.section_ptr("missing"), nullptr);
+    ASSERT_FALSE(doc.is_parsed("server.log"));
+}
+
+TEST(document_tests, section_ptr_test)
+{
+    inis::document doc;
+    doc.read_from_buffer("[a]\nx = 1\n[a.b]\nkey = 42\n[ab]\nkey = 0\n");
+    inis::section* sec = doc.section_ptr("a");
+    ASSERT_NE(sec, nullptr);
+    ASSERT_TRUE(doc.is_parsed("a.b"));
+    ASSERT_FALSE(doc.is_parsed("ab"));
+    ASSERT_NE(sec->subsection_ptr("b"), nullptr);
+    ASSERT_EQ(sec->setting<int>("b.key"), 42);
+
+    // The settings are still read from their section only.
+    inis::document lazy_doc;
+    lazy_doc.read_from_buffer("[a]\nx = 1\n[a.b]\nkey = 42\n");
+    ASSERT_EQ(lazy_doc.setting<int>("a.x"), 1);
+    ASSERT_FALSE(lazy_doc.is_parsed("a.b"));
+}
+
+TEST(document_tests, modified_settings_test)
+{
+    inis::document doc;
+    doc.read_from_buffer(document_text);
+    ASSERT_TRUE(doc.set_setting("server.host", std::string("example.org")));
+    ASSERT_TRUE(doc.set_setting("server.port", 8080));
+    ASSERT_TRUE(doc.set_setting("server.timeout", 30));
+    ASSERT_TRUE(doc.set_setting("server.text.body", std::string("single line")));
+    ASSERT_TRUE(doc.set_setting("name", std::string("multi\nline")));
+    ASSERT_TRUE(doc.set_setting("cache.size", 64));
+    ASSERT_FALSE(doc.is_parsed("server.log"));
+
+    constexpr std::string_view expected_text = R"inis(// Settings of the application.
+name =| END
+multi
+line
+END
+
+[server]
+host = example.org  // where to listen
+port = 8080
+timeout = 30
+
+// Logging:
+[server.log]
+level = info
+[.text]
+body = single line
+footer = end
+
+[cache]
+size = 64
+)inis";
+    ASSERT_EQ(written_text(doc, "END"), expected_text);
+
+    // The written text is read back as the modified tree.
+    inis::document read_doc;
+    read_doc.read_from_buffer(written_text(doc, "END"));
+    ASSERT_EQ(read_doc.setting<std::string>("name"), "multi\nline");
+    ASSERT_EQ(read_doc.setting<int>("server.timeout"), 30);
+    ASSERT_EQ(read_doc.setting<std::string>("server.text.body"), "single line");
+    ASSERT_EQ(read_doc.setting<int>("cache.size"), 64);
+    ASSERT_EQ(written_text(read_doc), expected_text);
+
+    // Same default end marker as a section (an empty line):
+    std::string default_text = written_text(doc);
+    ASSERT_TRUE(default_text.starts_with("// Settings of the application.\nname =| \nmulti\nline\n\n"));
+    std::ostringstream section_stream;
+    doc.tree().write_to_stream(section_stream);
+    ASSERT_NE(section_stream.str().find("name =| \nmulti\nline\n\n"), std::string::npos);
+    inis::document default_doc;
+    default_doc.read_from_buffer(default_text);
+    ASSERT_EQ(default_doc.setting<std::string>("name"), "multi\nline");
+    ASSERT_EQ(default_doc.setting<int>("server.port"), 8080);
+}
+
+TEST(document_tests, new_settings_in_sections_without_settings_test)
+{
+    inis::document doc;
+    doc.read_from_buffer("// comment\n[a.b]\nkey = value");
+    ASSERT_TRUE(doc.set_setting("first", 1));
+    ASSERT_TRUE(doc.set_setting("a.second", 2));
+    ASSERT_TRUE(doc.set_setting("a.b.third", 3));
+    ASSERT_EQ(written_text(doc), "first = 1\n// comment\n[a.b]\nkey = value\nthird = 3\n\n[a]\nsecond = 2\n");
+}
+
+TEST(document_tests, bad_header_test)
+{
+    inis::document doc;
+    doc.read_from_buffer("[a]\nkey = value\n");
+    ASSERT_THROW(doc.read_from_buffer("[a]\n[...b]\n"), std::runtime_error);
+    ASSERT_EQ(doc.setting<std::string>("a.key"), "value");
+}
+
+TEST(document_tests, write_to_file_test)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_document_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::filesystem::path path = dir / "settings.inis";
+    std::ofstream(path) << document_text;
+
+    inis::document doc;
+    doc.read_from_file(path);
+    ASSERT_EQ(doc.setting<std::string>("$settings_dir"),
+              std::filesystem::canonical(dir).generic_string());
+    ASSERT_TRUE(doc.set_setting("server.log.level", std::string("debug")));
+    // The file of the document is replaced, not modified while it is mapped.
+    doc.write_to_file(path);
+    ASSERT_EQ(doc.setting<std::string>("server.log.level"), "debug");
+
+    inis::section settings;
+    settings.read_from_file(path);
+    ASSERT_EQ(settings.setting<std::string>("server.log.level"), "debug");
+    ASSERT_EQ(settings.setting<std::string>("server.host"), "localhost");
+    ASSERT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 1);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(document_tests, include_test)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_document_include_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "common.inis") << "[db]\nuser = admin\n";
+    std::ofstream(dir / "settings.inis") << "@include common.inis\n[db]\nport = 5432\n";
+
+    inis::document doc;
+    doc.read_from_file(dir / "settings.inis");
+    ASSERT_TRUE(doc.is_parsed("db"));
+    ASSERT_EQ(doc.setting<std::string>("db.user"), "admin");
+    ASSERT_TRUE(doc.set_setting("db.port", 5433));
+    // The settings of the included file are not written back.
+    ASSERT_EQ(written_text(doc), "@include common.inis\n[db]\nport = 5433\n");
+
+    // Like a section, a buffer keeps the settings directory of the previous content, which is the base of its
+    // relative include directives:
+    inis::section settings;
+    settings.read_from_file(dir / "settings.inis");
+    const std::string buffer = "path = {$settings_dir}/file\n@include common.inis\n";
+    settings.read_from_buffer(buffer);
+    doc.read_from_buffer(buffer);
+    ASSERT_EQ(doc.setting<std::string>("$settings_dir"), std::filesystem::canonical(dir).generic_string());
+    ASSERT_EQ(doc.tree().formatted_setting("path"), settings.formatted_setting("path"));
+    ASSERT_EQ(doc.setting<std::string>("db.user"), "admin");
+    std::filesystem::remove_all(dir);
+}
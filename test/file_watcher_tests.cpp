@@ -0,0 +1,169 @@
+#include <arba/inis/file_watcher.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+class event_recorder
+{
+public:
+    void operator()(const inis::file_watcher::change_event& event)
+    {
+        std::lock_guard lock(mutex_);
+        events_.push_back(event);
+        condition_.notify_all();
+    }
+
+    bool wait_for_events(std::size_t number_of_events)
+    {
+        std::unique_lock lock(mutex_);
+        return condition_.wait_for(lock, 5s, [&] { return events_.size() >= number_of_events; });
+    }
+
+    std::vector<inis::file_watcher::change_event> events()
+    {
+        std::lock_guard lock(mutex_);
+        return events_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<inis::file_watcher::change_event> events_;
+};
+
+void write_file(const std::filesystem::path& path, const std::string& contents)
+{
+    std::ofstream(path) << contents;
+}
+
+void test_file_watcher(inis::file_watcher::backend backend)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_file_watcher_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::filesystem::path path = dir / "settings.inis";
+    const std::filesystem::path other_path = dir / "other.inis";
+    write_file(path, "number = 1\n[section]\nkey = value\n");
+    write_file(other_path, "number = 1\n");
+
+    inis::file_watcher watcher(20ms, backend, 20ms);
+    ASSERT_EQ(watcher.active_backend(), backend);
+    event_recorder recorder;
+    watcher.add_callback(std::ref(recorder));
+    inis::config_handle handle;
+    watcher.watch(path, handle);
+    inis::file_watcher::snapshot_ptr other_tree = watcher.watch(other_path);
+    ASSERT_EQ(handle.snapshot()->setting<int>("number"), 1);
+    ASSERT_EQ(other_tree->setting<int>("number"), 1);
+
+    // The size changes, so that the polling backend detects the modification even with a coarse file time:
+    write_file(path, "number = 22\n[section]\nkey = value\nnew_key = new_value\n");
+    ASSERT_TRUE(recorder.wait_for_events(1));
+    std::vector<inis::file_watcher::change_event> events = recorder.events();
+    ASSERT_EQ(events.size(), 1);
+    ASSERT_EQ(events[0].path, std::filesystem::absolute(path).lexically_normal());
+    ASSERT_EQ(events[0].changed_setting_paths, (std::vector<std::string>{ "number", "section.new_key" }));
+    ASSERT_EQ(events[0].tree->setting<int>("number"), 22);
+    ASSERT_EQ(handle.snapshot(), events[0].tree);
+    ASSERT_EQ(watcher.tree(path), events[0].tree);
+    ASSERT_EQ(watcher.tree(other_path), other_tree);
+
+    // Replacement by a rename:
+    write_file(dir / "settings.inis.tmp", "number = 333\n");
+    std::filesystem::rename(dir / "settings.inis.tmp", path);
+    ASSERT_TRUE(recorder.wait_for_events(2));
+    events = recorder.events();
+    ASSERT_EQ(events[1].changed_setting_paths,
+              (std::vector<std::string>{ "number", "section.key", "section.new_key" }));
+    ASSERT_EQ(handle.snapshot()->setting<int>("number"), 333);
+
+    watcher.unwatch(path);
+    ASSERT_EQ(watcher.tree(path), nullptr);
+    // The directory stays watched for the other file after a failed watch, and after the other file is watched again:
+    ASSERT_THROW(watcher.watch(dir / "missing.inis"), std::exception);
+    ASSERT_EQ(watcher.tree(dir / "missing.inis"), nullptr);
+    other_tree = watcher.watch(other_path);
+    ASSERT_EQ(other_tree->setting<int>("number"), 1);
+    write_file(other_path, "number = 4444\n");
+    ASSERT_TRUE(recorder.wait_for_events(3));
+    events = recorder.events();
+    ASSERT_EQ(events[2].path, std::filesystem::absolute(other_path).lexically_normal());
+    ASSERT_EQ(watcher.tree(other_path)->setting<int>("number"), 4444);
+    ASSERT_EQ(handle.snapshot()->setting<int>("number"), 333);
+
+    std::filesystem::remove_all(dir);
+}
+
+void test_file_watcher_includes(inis::file_watcher::backend backend)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_file_watcher_include_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "fragments");
+    const std::filesystem::path path = dir / "settings.inis";
+    const std::filesystem::path fragment_path = dir / "fragments" / "network.inis";
+    const std::filesystem::path other_fragment_path = dir / "fragments" / "database.inis";
+    write_file(path, "number = 1\n[network]\n@include fragments/network.inis\n");
+    write_file(fragment_path, "port = 80\n");
+    write_file(other_fragment_path, "user = admin\n");
+
+    inis::file_watcher watcher(20ms, backend, 20ms);
+    event_recorder recorder;
+    watcher.add_callback(std::ref(recorder));
+    ASSERT_EQ(watcher.watch(path)->setting<int>("network.port"), 80);
+
+    // The modification of an included file reloads the including file:
+    write_file(fragment_path, "port = 8080\n");
+    ASSERT_TRUE(recorder.wait_for_events(1));
+    std::vector<inis::file_watcher::change_event> events = recorder.events();
+    ASSERT_EQ(events[0].path, std::filesystem::absolute(path).lexically_normal());
+    ASSERT_EQ(events[0].changed_setting_paths, (std::vector<std::string>{ "network.port" }));
+    ASSERT_EQ(watcher.tree(path)->setting<int>("network.port"), 8080);
+
+    // The included files are updated by a reload:
+    write_file(path, "number = 22\n[database]\n@include fragments/database.inis\n");
+    ASSERT_TRUE(recorder.wait_for_events(2));
+    write_file(other_fragment_path, "user = root\n");
+    ASSERT_TRUE(recorder.wait_for_events(3));
+    events = recorder.events();
+    ASSERT_EQ(events[2].changed_setting_paths, (std::vector<std::string>{ "database.user" }));
+    ASSERT_EQ(watcher.tree(path)->setting<std::string>("database.user"), "root");
+
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+TEST(file_watcher_tests, polling_test)
+{
+    test_file_watcher(inis::file_watcher::backend::polling);
+}
+
+TEST(file_watcher_tests, inotify_test)
+{
+    if (!inis::file_watcher::is_supported(inis::file_watcher::backend::inotify))
+        GTEST_SKIP();
+    test_file_watcher(inis::file_watcher::backend::inotify);
+}
+
+TEST(file_watcher_tests, polling_include_test)
+{
+    test_file_watcher_includes(inis::file_watcher::backend::polling);
+}
+
+TEST(file_watcher_tests, inotify_include_test)
+{
+    if (!inis::file_watcher::is_supported(inis::file_watcher::backend::inotify))
+        GTEST_SKIP();
+    test_file_watcher_includes(inis::file_watcher::backend::inotify);
+}
@@ -0,0 +1,181 @@
+#include <arba/inis/frozen_config.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+inis::section make_settings()
+{
+    inis::section settings;
+    settings.read_from_buffer(R"inis(
+number = 42
+name = root_name
+empty =
+[alpha]
+flag = on
+real = 2.5
+[alpha.beta]
+number = 7
+name = beta_name
+[gamma.delta]
+name = root_name
+)inis");
+    return settings;
+}
+
+} // namespace
+
+TEST(frozen_config_tests, setting_test)
+{
+    const inis::section settings = make_settings();
+    const inis::frozen_config config(settings);
+
+    ASSERT_EQ(config.setting<int>("number"), 42);
+    ASSERT_EQ(config.setting<std::string>("name"), "root_name");
+    ASSERT_EQ(config.setting<std::string_view>("empty", "default"), "default");
+    ASSERT_TRUE(config.has_setting("empty"));
+    ASSERT_TRUE(config.setting<bool>("alpha.flag"));
+    ASSERT_DOUBLE_EQ(config.setting<double>("alpha.real"), 2.5);
+    ASSERT_EQ(config.setting<int>("alpha.beta.number"), 7);
+    ASSERT_EQ(config.setting<std::string>("alpha.beta.name"), "beta_name");
+    ASSERT_EQ(config.setting<std::string>("gamma.delta.name"), "root_name");
+    ASSERT_EQ(config.setting<int>("alpha.real", -1), -1);
+    ASSERT_EQ(config.setting<int>("alpha.missing", -1), -1);
+    ASSERT_EQ(config.setting<int>("missing.number", -1), -1);
+    ASSERT_FALSE(config.has_setting("alpha.beta"));
+    ASSERT_EQ(config.setting<std::string>(inis::section::tmp_dir),
+              settings.setting<std::string>(inis::section::tmp_dir));
+}
+
+TEST(frozen_config_tests, section_view_test)
+{
+    const inis::frozen_config config(make_settings());
+
+    ASSERT_TRUE(config.root().is_root());
+    ASSERT_TRUE(config.has_subsection("alpha.beta"));
+    ASSERT_FALSE(config.has_subsection("alpha.gamma"));
+    ASSERT_FALSE(config.has_subsection("alpha."));
+    ASSERT_EQ(config.number_of_sections(), 5);
+    ASSERT_EQ(config.root().number_of_sections(), 2);
+
+    inis::frozen_config::section_view alpha = config.subsection("alpha");
+    ASSERT_EQ(alpha.name(), "alpha");
+    ASSERT_FALSE(alpha.is_root());
+    ASSERT_EQ(alpha.number_of_settings(), 2);
+    ASSERT_EQ(alpha.setting<int>("beta.number"), 7);
+    ASSERT_EQ(alpha.subsection("beta").name(), "beta");
+    ASSERT_EQ(alpha.subsection("").name(), "alpha");
+    ASSERT_THROW(alpha.subsection("missing"), std::runtime_error);
+}
+
+TEST(frozen_config_tests, empty_config_test)
+{
+    const inis::frozen_config config;
+    ASSERT_EQ(config.number_of_sections(), 1);
+    ASSERT_EQ(config.number_of_settings(), 0);
+    ASSERT_FALSE(config.has_setting("number"));
+    ASSERT_EQ(config.setting<int>("number", 3), 3);
+}
+
+TEST(frozen_config_tests, memory_size_test)
+{
+    inis::section settings;
+    for (int i = 0; i < 100; ++i)
+    {
+        std::string section_path = "section_" + std::to_string(i);
+        settings.create_sections(section_path);
+        for (int j = 0; j < 10; ++j)
+            settings.set_setting(section_path + ".key_" + std::to_string(j), j);
+    }
+    const inis::frozen_config config(settings);
+    ASSERT_EQ(config.number_of_settings(), 1000);
+    ASSERT_EQ(config.setting<int>("section_42.key_7"), 7);
+    // The keys and the values are shared by the sections:
+    ASSERT_LT(config.memory_size(), 1000 * 24);
+}
+
+TEST(frozen_config_tests, formatted_values_test)
+{
+    inis::section settings;
+    settings.read_from_buffer(R"inis(
+rsc = resource
+[dir]
+path = {rsc}/{.file}
+file = file.txt
+)inis");
+    const inis::frozen_config raw_config(settings);
+    ASSERT_EQ(raw_config.setting<std::string>("dir.path"), "{rsc}/{.file}");
+    const inis::frozen_config formatted_config(settings, inis::frozen_config::Formatted_values);
+    ASSERT_EQ(formatted_config.setting<std::string>("dir.path"), "resource/file.txt");
+}
+
+TEST(frozen_config_tests, binary_image_test)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_frozen_config_tests.binis";
+    {
+        const inis::frozen_config config(make_settings());
+        config.write_binary(path);
+        ASSERT_EQ(std::filesystem::file_size(path), config.binary_image().size());
+    }
+
+    inis::frozen_config config = inis::frozen_config::read_binary(path);
+    ASSERT_EQ(config.setting<int>("number"), 42);
+    ASSERT_EQ(config.setting<std::string_view>("alpha.beta.name"), "beta_name");
+    ASSERT_TRUE(config.setting<bool>("alpha.flag"));
+    ASSERT_EQ(config.number_of_sections(), 5);
+
+    inis::frozen_config moved_config(std::move(config));
+    ASSERT_EQ(moved_config.setting<int>("alpha.beta.number"), 7);
+    std::filesystem::remove(path);
+}
+
+TEST(frozen_config_tests, invalid_binary_image_test)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_frozen_config_tests.binis";
+    std::ostringstream stream;
+    inis::frozen_config(make_settings()).write_binary(stream);
+    const std::string image = stream.str();
+
+    auto write_image = [&path](const std::string& bytes) { std::ofstream(path, std::ios::binary) << bytes; };
+
+    std::string corrupted_image = image;
+    corrupted_image.back() ^= 1;
+    write_image(corrupted_image);
+    ASSERT_THROW(inis::frozen_config::read_binary(path), std::runtime_error);
+
+    // The node ranges are checked even when the checksum is not:
+    // (header of 40 bytes, then the root node: name (8 bytes), parent, first_section, number_of_sections...)
+    auto write_root_node_field = [&](std::size_t field_offset, std::uint32_t field_value)
+    {
+        std::string bad_image = image;
+        std::memcpy(bad_image.data() + 40 + field_offset, &field_value, sizeof(field_value));
+        write_image(bad_image);
+    };
+    write_root_node_field(12, 0xfffffff0u); // first_section
+    ASSERT_THROW(inis::frozen_config::read_binary(path, false), std::runtime_error);
+    write_root_node_field(16, 1000); // number_of_sections
+    ASSERT_THROW(inis::frozen_config::read_binary(path, false), std::runtime_error);
+    write_root_node_field(24, 1000); // number_of_settings
+    ASSERT_THROW(inis::frozen_config::read_binary(path, false), std::runtime_error);
+    write_root_node_field(0, 0xfffffff0u); // name offset
+    ASSERT_THROW(inis::frozen_config::read_binary(path, false), std::runtime_error);
+
+    write_image(image.substr(0, image.size() - 1));
+    ASSERT_THROW(inis::frozen_config::read_binary(path), std::runtime_error);
+
+    corrupted_image = image;
+    corrupted_image[0] = 'X';
+    write_image(corrupted_image);
+    ASSERT_THROW(inis::frozen_config::read_binary(path), std::runtime_error);
+
+    write_image(image);
+    ASSERT_EQ(inis::frozen_config::read_binary(path).setting<int>("number"), 42);
+    std::filesystem::remove(path);
+}
@@ -1,9 +1,14 @@
 #include <arba/inis/inis.hpp>
+#include <arba/inis/mapped_file.hpp>
 
 #include <gtest/gtest.h>
 
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <optional>
+#include <sstream>
 
 using namespace std::literals::string_literals;
 using namespace std::literals::string_view_literals;
@@ -102,3 +107,909 @@ TEST(inis_tests, format_test)
 
     ASSERT_EQ(settings.formatted_setting("first.second.third.request"), "fst");
 }
+
+TEST(inis_tests, section_header_grammar_test)
+{
+    std::istringstream stream(R"inis(
+[good_1.section]
+[Section_2]
+key = 1
+[bad section]
+bad = 2
+[bad-section]
+[]
+ [indented]
+[.sub]
+key = 3
+)inis");
+    inis::section settings;
+    settings.read_from_stream(stream);
+
+    ASSERT_NE(settings.subsection_ptr("good_1.section"), nullptr);
+    ASSERT_EQ(settings.setting<int>("Section_2.key"), 1);
+    ASSERT_EQ(settings.setting<int>("Section_2.bad"), 2);
+    ASSERT_EQ(settings.subsection_ptr("bad section"), nullptr);
+    ASSERT_EQ(settings.subsection_ptr("bad-section"), nullptr);
+    ASSERT_EQ(settings.subsection_ptr("indented"), nullptr);
+    ASSERT_EQ(settings.setting<int>("Section_2.sub.key"), 3);
+
+    ASSERT_NE(settings.create_sections("a.b_c.D9"), nullptr);
+    ASSERT_EQ(settings.create_sections(""), nullptr);
+    ASSERT_EQ(settings.create_sections("a b"), nullptr);
+    ASSERT_EQ(settings.create_sections("a/b"), nullptr);
+    ASSERT_TRUE(settings.set_setting("a.b_c.D9.key", "value"));
+    ASSERT_EQ(settings.setting<std::string>("a.b_c.D9.key"), "value");
+    ASSERT_EQ(settings.subsection("a.b_c.D9").settings().count("key"), 1);
+    ASSERT_FALSE(settings.set_setting("a.b_c.D9.key-2", "value"));
+    ASSERT_FALSE(settings.set_setting("", "value"));
+}
+
+TEST(inis_tests, read_from_buffer_test)
+{
+    std::filesystem::path inis_filepath = rsc_dir / "inis/basic_settings.inis";
+    inis::mapped_file file(inis_filepath);
+    ASSERT_FALSE(file.empty());
+    inis::section settings;
+    settings.read_from_buffer(file.view());
+    ASSERT_EQ(settings.setting<std::string>("global_label"), "value");
+    ASSERT_EQ(settings.setting<std::string>("section.arg"), "Text on\nseveral lines.");
+    ASSERT_EQ(settings.setting<std::string>("section.text"), "Begin of the text...\n\n... end of the text.");
+    ASSERT_EQ(settings.setting<std::string>("section.splitted"), "A single line written on two lines in the file.");
+    ASSERT_DOUBLE_EQ(settings.setting<double>("section.subsection2.arg"), 46.5);
+
+    // Same line splitting as std::getline, even for an unterminated multi-line value:
+    for (std::string_view text : { "text =|\nline 1\nline 2", "text =|\nline 1\nline 2\n", "text =|\r\nline 1\r\n" })
+    {
+        std::istringstream stream{ std::string(text) };
+        inis::section stream_settings;
+        stream_settings.read_from_stream(stream);
+        inis::section buffer_settings;
+        buffer_settings.read_from_buffer(text);
+        ASSERT_EQ(buffer_settings.setting<std::string>("text"), stream_settings.setting<std::string>("text"));
+    }
+
+    ASSERT_THROW(inis::mapped_file(rsc_dir / "inis/missing.inis"), std::filesystem::filesystem_error);
+}
+
+TEST(inis_tests, compiled_path_test)
+{
+    std::istringstream stream(R"inis(
+[root.branch]
+number = 42
+)inis");
+    inis::section settings;
+    settings.read_from_stream(stream);
+
+    const inis::compiled_path number_path = settings.compile_path("root.branch.number");
+    const inis::compiled_path text_path = settings.compile_path("root.branch.leaf.text");
+    ASSERT_EQ(number_path.path(), "root.branch.number");
+    ASSERT_EQ(settings.setting<int>(number_path), 42);
+    ASSERT_EQ(settings.setting<std::string_view>(number_path), "42");
+    ASSERT_EQ(settings.setting<std::string>(text_path), "");
+    ASSERT_EQ(settings.setting<std::string_view>(text_path, "default"), "default");
+
+    // Value modification:
+    ASSERT_TRUE(settings.set_setting("root.branch.number", 7));
+    ASSERT_EQ(settings.setting<int>(number_path), 7);
+
+    // Structure modification:
+    ASSERT_NE(settings.create_sections("root.branch.leaf"), nullptr);
+    ASSERT_TRUE(settings.set_setting("root.branch.leaf.text", "text"));
+    ASSERT_EQ(settings.setting<std::string>(text_path), "text");
+
+    // Compiled path used with another section:
+    const inis::section& branch = settings.subsection("root.branch");
+    ASSERT_EQ(branch.setting<int>(settings.compile_path("number")), 7);
+
+    // Tree rebuilt at the same address, with the same structure modifications:
+    std::optional<inis::section> tree(std::in_place);
+    tree->read_from_buffer("number = 1");
+    const inis::compiled_path tree_number_path = tree->compile_path("number");
+    ASSERT_EQ(tree->setting<int>(tree_number_path), 1);
+    tree.emplace();
+    tree->read_from_buffer("number = 2");
+    ASSERT_EQ(tree->setting<int>(tree_number_path), 2);
+
+    // Compiled paths of a moved tree are resolved again:
+    inis::section moved_from;
+    moved_from.read_from_buffer("[a]\nnumber = 3");
+    const inis::compiled_path moved_number_path = moved_from.compile_path("a.number");
+    ASSERT_EQ(moved_from.setting<int>(moved_number_path), 3);
+    {
+        inis::section moved_to(std::move(moved_from));
+        ASSERT_EQ(moved_to.setting<int>(moved_number_path), 3);
+    }
+    ASSERT_EQ(moved_from.setting<int>(moved_number_path, -1), -1);
+    moved_from.read_from_buffer("[a]\nnumber = 4");
+    ASSERT_EQ(moved_from.setting<int>(moved_number_path), 4);
+    {
+        inis::section assigned;
+        assigned = std::move(moved_from);
+        ASSERT_EQ(assigned.setting<int>(moved_number_path), 4);
+    }
+    ASSERT_EQ(moved_from.setting<int>(moved_number_path, -1), -1);
+}
+
+TEST(inis_tests, formatted_setting_cache_test)
+{
+    std::filesystem::path inis_filepath = rsc_dir / "inis/settings.inis";
+    inis::section settings;
+    settings.read_from_file(inis_filepath);
+
+    ASSERT_EQ(settings.formatted_setting("vfs.img"), "resource/image");
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.key_2_3"), "value_2_3");
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.special"), "value_2resource/video");
+    // Absolute references are resolved from the section used as root:
+    ASSERT_EQ(settings.subsection("vfs").formatted_setting("img"), "{vfs.rsc}/{dirname.img}");
+
+    // Modification of a dependency:
+    ASSERT_TRUE(settings.set_setting("root.branch.leaf.key", "other"));
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.key_2_3"), "other_2_3");
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.special"), "other_2resource/video");
+    ASSERT_TRUE(settings.set_setting("vfs.rsc", "rsc"));
+    ASSERT_EQ(settings.formatted_setting("vfs.img"), "rsc/image");
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.special"), "other_2rsc/video");
+
+    // Modification of the setting itself:
+    ASSERT_TRUE(settings.set_setting("vfs.img", "{vfs.rsc}/{dirname.vid}"));
+    ASSERT_EQ(settings.formatted_setting("vfs.img"), "rsc/video");
+
+    // A reference which becomes resolvable:
+    ASSERT_TRUE(settings.set_setting("vfs.doc", "{vfs.new_rsc}/{unknown.key}"));
+    ASSERT_EQ(settings.formatted_setting("vfs.doc"), "{vfs.new_rsc}/{unknown.key}");
+    ASSERT_TRUE(settings.set_setting("vfs.new_rsc", "new"));
+    ASSERT_EQ(settings.formatted_setting("vfs.doc"), "new/{unknown.key}");
+}
+
+TEST(inis_tests, cyclic_reference_test)
+{
+    std::istringstream stream(R"inis(
+self = {self}
+a = {section.b}
+[section]
+b = x{.c}
+c = {a}
+)inis");
+    inis::section settings;
+    settings.read_from_stream(stream);
+
+    ASSERT_THROW(settings.formatted_setting("self"), std::runtime_error);
+    ASSERT_THROW(settings.formatted_setting("a"), std::runtime_error);
+    ASSERT_THROW(settings.formatted_setting("section.c"), std::runtime_error);
+    ASSERT_THROW(settings.resolve_all(), std::runtime_error);
+
+    ASSERT_TRUE(settings.set_setting("self", "self"));
+    ASSERT_TRUE(settings.set_setting("section.c", "c"));
+    ASSERT_EQ(settings.formatted_setting("self"), "self");
+    ASSERT_EQ(settings.formatted_setting("a"), "xc");
+}
+
+TEST(inis_tests, long_reference_chain_test)
+{
+    // v0 = {v1}, v1 = {v2}, ...: the chain is longer than the call stack would allow with one call per reference.
+    constexpr int chain_length = 50000;
+    std::string buffer;
+    for (int i = 0; i < chain_length; ++i)
+        buffer += "v" + std::to_string(i) + " = {v" + std::to_string(i + 1) + "}\n";
+    inis::section settings;
+    settings.read_from_buffer(buffer + "v" + std::to_string(chain_length) + " = end\n");
+
+    ASSERT_EQ(settings.formatted_setting("v0"), "end");
+    ASSERT_EQ(settings.formatted_setting("v" + std::to_string(chain_length / 2)), "end");
+    ASSERT_TRUE(settings.set_setting("v" + std::to_string(chain_length), "new_end"));
+    ASSERT_EQ(settings.formatted_setting("v0"), "new_end");
+    settings.resolve_all();
+    ASSERT_EQ(settings.setting<std::string>("v0"), "new_end");
+
+    // A cycle as long as the chain:
+    inis::section cyclic_settings;
+    cyclic_settings.read_from_buffer(buffer + "v" + std::to_string(chain_length) + " = {v0}\n");
+    ASSERT_THROW(cyclic_settings.formatted_setting("v0"), std::runtime_error);
+}
+
+TEST(inis_tests, resolve_all_test)
+{
+    std::filesystem::path inis_filepath = rsc_dir / "inis/settings.inis";
+    inis::section settings;
+    settings.read_from_file(inis_filepath);
+    settings.resolve_all();
+
+    ASSERT_EQ(settings.setting<std::string>("comment"), "{Version: '0.1.0'}");
+    ASSERT_EQ(settings.setting<std::string>("vfs.img"), "resource/image");
+    ASSERT_EQ(settings.setting<std::string>("vfs.vid"), "resource/video");
+    ASSERT_EQ(settings.setting<std::string>("vfs.doc"), "Resource dir: 'global_rsc'");
+    ASSERT_EQ(settings.setting<std::string>("first.second.third.request"), "fst");
+    ASSERT_EQ(settings.setting<std::string>("root.branch.leaf.key_2_3"), "value_2_3");
+    ASSERT_EQ(settings.setting<std::string>("root.branch.leaf.special"), "value_2resource/video");
+    ASSERT_EQ(settings.formatted_setting("root.branch.leaf.special"), "value_2resource/video");
+}
+
+TEST(inis_tests, setting_value_conversion_test)
+{
+    ASSERT_EQ(inis::setting_value("42").to<int>(), 42);
+    ASSERT_EQ(inis::setting_value("-42").to<long long>(), -42);
+    ASSERT_EQ(inis::setting_value("+42").to<int>(), 42);
+    ASSERT_EQ(inis::setting_value(" 42").to<int>(), 42);
+    ASSERT_EQ(inis::setting_value("42 ").to<int>(-1), -1);
+    ASSERT_EQ(inis::setting_value("4 2").to<int>(-1), -1);
+    ASSERT_EQ(inis::setting_value("+-42").to<int>(-1), -1);
+    ASSERT_EQ(inis::setting_value("+").to<int>(-1), -1);
+    ASSERT_EQ(inis::setting_value("99999999999").to<int>(-1), -1);
+    ASSERT_EQ(inis::setting_value("-1").to<unsigned>(7), 7);
+    ASSERT_EQ(inis::setting_value("300").to<unsigned short>(), 300);
+    ASSERT_DOUBLE_EQ(inis::setting_value("-2.5e3").to<double>(), -2500.);
+    ASSERT_FLOAT_EQ(inis::setting_value(".5").to<float>(), 0.5f);
+    ASSERT_DOUBLE_EQ(inis::setting_value("2.5x").to<double>(-1.), -1.);
+
+    for (std::string_view text : { "1", "true", "True", "TRUE", "yes", "Yes", "on", "ON" })
+        ASSERT_TRUE(inis::setting_value(std::string(text)).to<bool>(false)) << text;
+    for (std::string_view text : { "0", "false", "False", "no", "NO", "off", "Off" })
+        ASSERT_FALSE(inis::setting_value(std::string(text)).to<bool>(true)) << text;
+    ASSERT_TRUE(inis::setting_value("2").to<bool>(true));
+    ASSERT_FALSE(inis::setting_value("truest").to<bool>(false));
+
+    ASSERT_EQ(inis::value_to_setting_string(-42), "-42");
+    ASSERT_EQ(inis::value_to_setting_string(true), "true");
+    ASSERT_EQ(inis::value_to_setting_string(false), "false");
+    ASSERT_EQ(inis::value_to_setting_string('c'), "c");
+    const double value = 0.1 + 0.2;
+    ASSERT_EQ(inis::setting_value(inis::value_to_setting_string(value)).to<double>(), value);
+}
+
+TEST(inis_tests, typed_value_cache_test)
+{
+    std::istringstream stream(R"inis(
+number = 42
+big_number = 3000000000
+real = 2.5
+flag = yes
+[section]
+text = text
+)inis");
+    inis::section settings;
+    ASSERT_FALSE(settings.is_typed_value_cache_enabled());
+    settings.enable_typed_value_cache();
+    settings.read_from_stream(stream);
+    ASSERT_TRUE(settings.is_typed_value_cache_enabled());
+    ASSERT_TRUE(settings.subsection("section").is_typed_value_cache_enabled());
+    ASSERT_TRUE(settings.settings().at("number").is_typed_value_cache_enabled());
+
+    ASSERT_EQ(settings.setting<int>("number"), 42);
+    ASSERT_EQ(settings.setting<int>("number"), 42);
+    ASSERT_EQ(settings.setting<unsigned short>("number"), 42);
+    ASSERT_DOUBLE_EQ(settings.setting<double>("number"), 42.);
+    ASSERT_EQ(settings.setting<long>("number"), 42);
+    ASSERT_EQ(settings.setting<int>("big_number", -1), -1);
+    ASSERT_EQ(settings.setting<long long>("big_number"), 3000000000);
+    ASSERT_EQ(settings.setting<int>("big_number", -1), -1);
+    ASSERT_EQ(settings.setting<unsigned>("big_number"), 3000000000u);
+    ASSERT_DOUBLE_EQ(settings.setting<double>("real"), 2.5);
+    ASSERT_DOUBLE_EQ(settings.setting<double>("real"), 2.5);
+    ASSERT_EQ(settings.setting<int>("real", -1), -1);
+    ASSERT_TRUE(settings.setting<bool>("flag"));
+    ASSERT_TRUE(settings.setting<bool>("flag"));
+    ASSERT_EQ(settings.setting<int>("section.text", -1), -1);
+
+    // Invalidation:
+    ASSERT_TRUE(settings.set_setting("number", 7));
+    ASSERT_EQ(settings.setting<int>("number"), 7);
+    ASSERT_TRUE(settings.set_setting("flag", "off"));
+    ASSERT_FALSE(settings.setting<bool>("flag"));
+    ASSERT_TRUE(settings.set_setting("section.new_number", 8));
+    ASSERT_TRUE(settings.subsection("section").settings().at("new_number").is_typed_value_cache_enabled());
+    ASSERT_EQ(settings.setting<int>("section.new_number"), 8);
+
+    // Every modification of a value clears its cache (a copy has an empty cache):
+    inis::setting_value value = settings.settings().at("number");
+    ASSERT_TRUE(value.is_typed_value_cache_enabled());
+    ASSERT_EQ(value.to<int>(), 7);
+    value.append("1");
+    ASSERT_EQ(value.to<int>(), 71);
+    value.push_back('2');
+    ASSERT_EQ(value.to<int>(), 712);
+    value.clear();
+    ASSERT_EQ(value.to<int>(-1), -1);
+    value = std::string("5");
+    ASSERT_EQ(value.to<int>(), 5);
+    value.insert(0, "1");
+    ASSERT_EQ(value.to<int>(), 15);
+    value.replace(1, 1, "6");
+    ASSERT_EQ(value.to<int>(), 16);
+    value[0] = '2';
+    ASSERT_EQ(value.to<int>(), 26);
+    value += "0";
+    ASSERT_EQ(value.to<int>(), 260);
+    value.erase(2);
+    ASSERT_EQ(value.to<int>(), 26);
+    ASSERT_EQ(inis::setting_value("3").to<int>(), 3);
+
+    // A setting value is a std::string:
+    const std::string& text = value;
+    ASSERT_EQ(text, "26");
+    ASSERT_EQ(value.compare("26"), 0);
+    ASSERT_TRUE(value.starts_with('2'));
+    ASSERT_EQ(value.rfind('6'), 1);
+    ASSERT_EQ(value + "!", "26!");
+    ASSERT_FALSE(inis::setting_value("3").is_typed_value_cache_enabled());
+
+    settings.enable_typed_value_cache(false);
+    ASSERT_FALSE(settings.settings().at("number").is_typed_value_cache_enabled());
+    ASSERT_EQ(settings.setting<int>("number"), 7);
+}
+
+namespace
+{
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    std::size_t allocations = 0;
+    std::size_t deallocations = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        ++deallocations;
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+} // namespace
+
+TEST(inis_tests, memory_resource_test)
+{
+    counting_resource resource;
+    {
+        inis::section settings(&resource);
+        ASSERT_EQ(settings.resource(), &resource);
+        settings.read_from_buffer(R"inis(
+number = 42
+a_setting_name_which_does_not_fit_in_the_small_string_buffer = value
+[section.subsection]
+text = text
+)inis");
+        ASSERT_EQ(settings.subsection("section").resource(), &resource);
+        ASSERT_EQ(settings.subsection("section.subsection").resource(), &resource);
+        ASSERT_TRUE(settings.set_setting("section.new_number", 8));
+        ASSERT_EQ(settings.setting<int>("number"), 42);
+        ASSERT_EQ(settings.setting<std::string>("a_setting_name_which_does_not_fit_in_the_small_string_buffer"),
+                  "value");
+        ASSERT_EQ(settings.setting<int>("section.new_number"), 8);
+        ASSERT_GT(resource.allocations, 0);
+
+        inis::section moved_settings(std::move(settings));
+        ASSERT_EQ(moved_settings.resource(), &resource);
+        ASSERT_EQ(moved_settings.subsection("section.subsection").parent(), &moved_settings.subsection("section"));
+        ASSERT_EQ(moved_settings.setting<std::string>("section.subsection.text"), "text");
+    }
+    ASSERT_EQ(resource.allocations, resource.deallocations);
+
+    std::pmr::monotonic_buffer_resource arena;
+    inis::section settings(&arena);
+    settings.read_from_buffer("[section]\nnumber = 42\n");
+    ASSERT_EQ(settings.setting<int>("section.number"), 42);
+
+    // A tree moved to a tree with another memory resource does not use the memory of its resource anymore:
+    inis::section assigned_settings;
+    {
+        std::pmr::monotonic_buffer_resource scoped_arena;
+        inis::section scoped_settings(&scoped_arena);
+        scoped_settings.read_from_buffer("[x]\nk = 1\n[.y]\nz = 2\n");
+        assigned_settings = std::move(scoped_settings);
+    }
+    ASSERT_EQ(assigned_settings.setting<int>("x.k"), 1);
+    ASSERT_EQ(assigned_settings.setting<int>("x.y.z"), 2);
+    ASSERT_EQ(assigned_settings.subsection("x.y").resource(), assigned_settings.resource());
+    ASSERT_EQ(assigned_settings.subsection("x.y").parent(), &assigned_settings.subsection("x"));
+}
+
+TEST(inis_tests, changed_setting_paths_test)
+{
+    inis::section before;
+    before.read_from_buffer(R"inis(
+number = 1
+removed = x
+[section]
+key = value
+[section.removed_section]
+key = value
+)inis");
+    inis::section after;
+    after.read_from_buffer(R"inis(
+number = 2
+added = x
+[section]
+key = value
+[section.added_section.subsection]
+key = value
+)inis");
+    ASSERT_EQ(before.changed_setting_paths(after),
+              (std::vector<std::string>{ "added", "number", "removed", "section.added_section.subsection.key",
+                                         "section.removed_section.key" }));
+    ASSERT_TRUE(before.changed_setting_paths(before).empty());
+}
+
+TEST(inis_tests, reload_test)
+{
+    inis::section settings;
+    settings.read_from_buffer(R"inis(
+number = 1
+kept = kept
+removed = x
+path = {kept}/{number}
+[section]
+key = value
+[section.removed_section]
+key = value
+)inis");
+    const inis::setting_value* kept_value = &settings.settings().at("kept");
+    const inis::setting_value* number_value = &settings.settings().at("number");
+    const inis::section* section_ptr = &settings.subsection("section");
+    ASSERT_EQ(settings.formatted_setting("path"), "kept/1");
+
+    inis::section::change_set changes = settings.reload_from_buffer(R"inis(
+number = 2
+kept = kept
+added = x
+path = {kept}/{number}
+[section]
+key = value
+[section.added_section.subsection]
+key = value
+)inis");
+    ASSERT_EQ(changes.added, (std::vector<std::string>{ "added", "section.added_section.subsection.key" }));
+    ASSERT_EQ(changes.removed, (std::vector<std::string>{ "removed", "section.removed_section.key" }));
+    ASSERT_EQ(changes.modified, (std::vector<std::string>{ "number" }));
+
+    ASSERT_EQ(&settings.settings().at("kept"), kept_value);
+    ASSERT_EQ(&settings.settings().at("number"), number_value);
+    ASSERT_EQ(&settings.subsection("section"), section_ptr);
+    ASSERT_EQ(settings.setting<int>("number"), 2);
+    ASSERT_EQ(settings.formatted_setting("path"), "kept/2");
+    ASSERT_EQ(settings.subsection_ptr("section.removed_section"), nullptr);
+    ASSERT_EQ(settings.subsection("section.added_section").parent(), section_ptr);
+    ASSERT_EQ(settings.setting<std::string>("section.added_section.subsection.key"), "value");
+
+    changes = settings.reload_from_buffer(R"inis(
+number = 2
+kept = kept
+added = x
+path = {kept}/{number}
+[section]
+key = value
+[section.added_section.subsection]
+key = value
+)inis");
+    ASSERT_TRUE(changes.empty());
+}
+
+TEST(inis_tests, reload_special_settings_test)
+{
+    inis::section settings;
+    settings.read_from_file(rsc_dir / "inis/basic_settings.inis");
+    const std::string settings_dir = settings.setting<std::string>(inis::section::settings_dir);
+
+    // The special settings are kept, and not reported as removed.
+    inis::section::change_set changes = settings.reload_from_buffer("global_label = new value\n[section]\nlevel = 0\n");
+    ASSERT_TRUE(changes.added.empty());
+    ASSERT_EQ(changes.removed.front(), "bad_int");
+    ASSERT_EQ(changes.modified, (std::vector<std::string>{ "global_label" }));
+    ASSERT_EQ(settings.setting<std::string>(inis::section::settings_dir), settings_dir);
+    ASSERT_NE(settings.setting<std::string>(inis::section::working_dir), "");
+
+    // The special settings of the new tree are not merged in a section which is not the root.
+    inis::section& section = settings.subsection("section");
+    changes = section.reload_from_buffer("level = 1\n");
+    ASSERT_TRUE(changes.added.empty());
+    ASSERT_EQ(changes.modified, (std::vector<std::string>{ "level" }));
+    ASSERT_EQ(section.settings().size(), 1);
+
+    // A reload from another file moves the settings directory:
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_reload_special_settings";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "settings.inis") << "global_label = new value\npath = {$settings_dir}/file\n[section]\n"
+                                            "level = 1\n";
+    ASSERT_EQ(settings.formatted_setting("global_label"), "new value");
+    changes = settings.reload_from_file(dir / "settings.inis");
+    ASSERT_EQ(changes.added, (std::vector<std::string>{ "path" }));
+    const std::string new_settings_dir = std::filesystem::canonical(dir).generic_string();
+    ASSERT_EQ(settings.setting<std::string>(inis::section::settings_dir), new_settings_dir);
+    ASSERT_EQ(settings.formatted_setting("path"), new_settings_dir + "/file");
+    std::filesystem::remove_all(dir);
+}
+
+TEST(inis_tests, reload_empty_section_test)
+{
+    inis::section settings;
+    settings.read_from_buffer("[section]\nkey = value\n");
+
+    // Adding or removing an empty section changes the structure of the tree, but no setting:
+    std::uint64_t structure_generation = settings.structure_generation();
+    inis::section::change_set changes = settings.reload_from_buffer("[section]\nkey = value\n[empty]\n");
+    ASSERT_TRUE(changes.empty());
+    ASSERT_NE(settings.subsection_ptr("empty"), nullptr);
+    ASSERT_NE(settings.structure_generation(), structure_generation);
+
+    structure_generation = settings.structure_generation();
+    changes = settings.reload_from_buffer("[section]\nkey = value\n");
+    ASSERT_TRUE(changes.empty());
+    ASSERT_EQ(settings.subsection_ptr("empty"), nullptr);
+    ASSERT_NE(settings.structure_generation(), structure_generation);
+
+    // Same structure:
+    structure_generation = settings.structure_generation();
+    changes = settings.reload_from_buffer("[section]\nkey = other value\n");
+    ASSERT_EQ(changes.modified, (std::vector<std::string>{ "section.key" }));
+    ASSERT_EQ(settings.structure_generation(), structure_generation);
+}
+
+TEST(inis_tests, subscribe_test)
+{
+    inis::section settings;
+    settings.read_from_buffer(R"inis(
+number = 1
+[section]
+key = value
+[section.subsection]
+key = value
+[other]
+key = value
+)inis");
+
+    std::vector<std::vector<std::string>> all_batches;
+    std::vector<std::vector<std::string>> section_batches;
+    std::vector<std::vector<std::string>> key_batches;
+    settings.subscribe("", [&](const std::vector<std::string>& paths) { all_batches.push_back(paths); });
+    const std::size_t section_id = settings.subscribe(
+        "section", [&](const std::vector<std::string>& paths) { section_batches.push_back(paths); });
+    settings.subsection("section").subscribe(
+        "subsection.key", [&](const std::vector<std::string>& paths) { key_batches.push_back(paths); });
+
+    ASSERT_TRUE(settings.set_setting("number", 2));
+    ASSERT_TRUE(settings.set_setting("number", 2)); // not modified
+    ASSERT_TRUE(settings.set_setting("section.subsection.key", "new value"));
+    ASSERT_TRUE(settings.subsection("other").set_setting("key", "new value"));
+    settings.create_sections("section.new_section.leaf");
+    settings.create_sections("section.new_section"); // already created
+    ASSERT_EQ(all_batches, (std::vector<std::vector<std::string>>{ { "number" },
+                                                                    { "section.subsection.key" },
+                                                                    { "other.key" },
+                                                                    { "section.new_section.leaf" } }));
+    ASSERT_EQ(section_batches,
+              (std::vector<std::vector<std::string>>{ { "section.subsection.key" }, { "section.new_section.leaf" } }));
+    ASSERT_EQ(key_batches, (std::vector<std::vector<std::string>>{ { "section.subsection.key" } }));
+
+    all_batches.clear();
+    section_batches.clear();
+    key_batches.clear();
+    inis::section::change_set changes = settings.reload_from_buffer(R"inis(
+number = 3
+[section]
+key = new value
+added = value
+[section.subsection]
+key = new value
+[other]
+key = new value
+)inis");
+    ASSERT_EQ(changes.modified, (std::vector<std::string>{ "number", "section.key" }));
+    ASSERT_EQ(all_batches, (std::vector<std::vector<std::string>>{ { "section.added", "number", "section.key" } }));
+    ASSERT_EQ(section_batches, (std::vector<std::vector<std::string>>{ { "section.added", "section.key" } }));
+    ASSERT_TRUE(key_batches.empty());
+
+    section_batches.clear();
+    settings.unsubscribe(section_id);
+    ASSERT_TRUE(settings.set_setting("section.key", "value"));
+    ASSERT_TRUE(section_batches.empty());
+    ASSERT_EQ(all_batches.size(), 2);
+
+    // A path can be subscribed again after its trie nodes were removed by unsubscribe().
+    const std::size_t leaf_id = settings.subscribe(
+        "section.new_section.leaf", [&](const std::vector<std::string>& paths) { section_batches.push_back(paths); });
+    settings.unsubscribe(leaf_id);
+    settings.subscribe("section.new_section",
+                       [&](const std::vector<std::string>& paths) { section_batches.push_back(paths); });
+    settings.create_sections("section.new_section.other");
+    ASSERT_EQ(section_batches, (std::vector<std::vector<std::string>>{ { "section.new_section.other" } }));
+}
+
+TEST(inis_tests, subscribe_move_assignment_test)
+{
+    std::vector<std::vector<std::string>> batches;
+    inis::section settings;
+    settings.read_from_buffer("number = 1\n[section]\nkey = value\n");
+    settings.subscribe("", [&](const std::vector<std::string>& paths) { batches.push_back(paths); });
+
+    // The subscriptions of the assigned tree are kept, and notified of the changes.
+    inis::section new_settings;
+    new_settings.read_from_buffer("number = 2\n[section]\nkey = value\n");
+    settings = std::move(new_settings);
+    ASSERT_EQ(batches, (std::vector<std::vector<std::string>>{ { "number" } }));
+
+    // The subscriptions move with their tree.
+    inis::section moved_settings;
+    moved_settings = std::move(settings);
+    ASSERT_TRUE(moved_settings.set_setting("section.key", "new value"));
+    ASSERT_EQ(batches, (std::vector<std::vector<std::string>>{ { "number" }, { "section.key" } }));
+}
+
+TEST(inis_tests, include_test)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_include_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "fragments");
+    std::ofstream(dir / "settings.inis") << R"inis(
+name = main
+@include fragments/network.inis
+[database]
+@include "fragments/database.inis" // comment
+user = admin
+)inis";
+    std::ofstream(dir / "fragments" / "network.inis") << R"inis(
+[network]
+port = 8080
+@include ../common.inis
+)inis";
+    std::ofstream(dir / "fragments" / "database.inis") << R"inis(
+host = localhost
+text =|END
+@include not_a_file.inis
+END
+[.pool]
+size = 4
+)inis";
+    std::ofstream(dir / "common.inis") << "timeout = 30\n";
+
+    inis::section settings;
+    settings.read_from_file(dir / "settings.inis");
+    ASSERT_EQ(settings.setting<std::string>("name"), "main");
+    ASSERT_EQ(settings.setting<int>("network.port"), 8080);
+    ASSERT_EQ(settings.setting<int>("network.timeout"), 30);
+    ASSERT_EQ(settings.setting<std::string>("database.host"), "localhost");
+    ASSERT_EQ(settings.setting<std::string>("database.text"), "@include not_a_file.inis");
+    ASSERT_EQ(settings.setting<int>("database.pool.size"), 4);
+    // The section of the include directive is the current section after the included lines:
+    ASSERT_EQ(settings.setting<std::string>("database.user"), "admin");
+    ASSERT_FALSE(settings.subsection("database.pool").settings().contains("user"));
+
+    // The included files of a buffer are relative to $settings_dir:
+    inis::section buffer_settings;
+    buffer_settings.read_from_file(dir / "common.inis");
+    buffer_settings.read_from_buffer("[network]\n@include fragments/database.inis\n");
+    ASSERT_EQ(buffer_settings.setting<int>("network.pool.size"), 4);
+
+    std::ofstream(dir / "common.inis") << "@include settings.inis\n";
+    inis::section cyclic_settings;
+    ASSERT_THROW(cyclic_settings.read_from_file(dir / "settings.inis"), std::runtime_error);
+
+    std::ofstream(dir / "common.inis") << "@include missing.inis\n";
+    inis::section missing_settings;
+    ASSERT_THROW(missing_settings.read_from_file(dir / "settings.inis"), std::exception);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(inis_tests, read_from_directory_test)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_directory_tests";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "subdir");
+    for (int index = 0; index < 16; ++index)
+        std::ofstream(dir / ("file_" + std::to_string(index) + ".inis"))
+            << "index = " << index << "\n[section]\npath = {$settings_dir}/file\n";
+    std::ofstream(dir / "ignored.txt") << "index = -1\n";
+    std::ofstream(dir / "not.a.section.inis") << "index = -1\n";
+    std::ofstream(dir / "subdir" / "ignored.inis") << "index = -1\n";
+
+    inis::section settings;
+    settings.read_from_file(dir / "file_0.inis");
+    settings.read_from_directory(dir, inis::section::directory_options{ ".inis", 4 });
+    for (int index = 0; index < 16; ++index)
+    {
+        const std::string name = "file_" + std::to_string(index);
+        const inis::section& file_section = settings.subsection(name);
+        ASSERT_EQ(file_section.parent(), &settings);
+        ASSERT_EQ(settings.setting<int>(name + ".index"), index);
+        ASSERT_FALSE(file_section.settings().contains("$settings_dir"));
+        ASSERT_EQ(settings.formatted_setting(name + ".section.path"),
+                  std::filesystem::canonical(dir).generic_string() + "/file");
+    }
+    ASSERT_EQ(settings.setting<int>("index"), 0);
+    ASSERT_EQ(settings.subsection_ptr("ignored"), nullptr);
+    ASSERT_EQ(settings.subsection_ptr("not"), nullptr);
+
+    // The trees read from the directory can be modified and moved with the root.
+    ASSERT_NE(settings.create_sections("file_1.new_section"), nullptr);
+    ASSERT_TRUE(settings.set_setting("file_1.new_section.key", "value"));
+    inis::section moved_settings(std::move(settings));
+    ASSERT_EQ(moved_settings.setting<std::string>("file_1.new_section.key"), "value");
+    moved_settings.read_from_directory(dir);
+    ASSERT_EQ(moved_settings.subsection_ptr("file_1.new_section"), nullptr);
+
+    // The settings directory of a root read from a file is kept.
+    inis::section subdir_settings;
+    subdir_settings.read_from_file(dir / "subdir" / "ignored.inis");
+    subdir_settings.read_from_directory(dir);
+    ASSERT_EQ(subdir_settings.setting<std::string>("$settings_dir"),
+              std::filesystem::canonical(dir / "subdir").generic_string());
+    ASSERT_EQ(subdir_settings.setting<int>("file_3.index"), 3);
+
+    std::ofstream(dir / "file_5.inis") << "[.bad_section]\n";
+    inis::section failed_settings;
+    ASSERT_THROW(failed_settings.read_from_directory(dir), std::runtime_error);
+    ASSERT_EQ(failed_settings.subsection_ptr("file_0"), nullptr);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(inis_tests, write_test)
+{
+    inis::section settings;
+    settings.read_from_buffer(R"inis(
+key = value
+[a]
+[.b]
+text =|END
+line 1
+line 2
+END
+[..c]
+number = 42
+[a.d]
+key = d
+)inis");
+    std::ostringstream stream;
+    settings.write_to_stream(stream, "END");
+    inis::section written_settings;
+    written_settings.read_from_buffer(stream.str());
+    ASSERT_TRUE(settings.changed_setting_paths(written_settings).empty());
+    ASSERT_EQ(written_settings.setting<int>("a.b.c.number"), 42);
+    ASSERT_EQ(written_settings.setting<std::string>("a.b.text"), "line 1\nline 2");
+
+    // The text is written in several chunks:
+    for (int index = 0; index < 10000; ++index)
+        ASSERT_TRUE(settings.set_setting("a.d.key_" + std::to_string(index), std::string(index % 64, 'x')));
+    stream.str("");
+    settings.write_to_stream(stream, "END");
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "arba_inis_write_test.inis";
+    settings.write_to_file(path, "END");
+    {
+        inis::mapped_file file(path);
+        ASSERT_EQ(file.view(), stream.str());
+    }
+    std::filesystem::remove(path);
+    ASSERT_THROW(settings.write_to_file(path / "not_a_directory" / "settings.inis", ""),
+                 std::filesystem::filesystem_error);
+}
+
+TEST(inis_tests, declaration_order_test)
+{
+    const std::string text = "zeta = 1\nalpha = 2\nmiddle = 3\n\n[zulu]\nb = 1\na = 2\n\n[.yankee]\nkey = y\n\n"
+                             "[alpha]\nkey = a\n\n";
+    inis::section settings;
+    settings.read_from_buffer(text);
+    ASSERT_EQ(settings.settings_in_order().size(), settings.settings().size());
+    ASSERT_EQ(settings.sections_in_order().front()->first, "zulu");
+    std::ostringstream stream;
+    settings.write_to_stream(stream);
+    ASSERT_EQ(stream.str(), text);
+
+    // New settings are written after the existing ones:
+    ASSERT_TRUE(settings.set_setting("zulu.new_key", "n"));
+    stream.str("");
+    settings.write_to_stream(stream);
+    ASSERT_EQ(stream.str(), "zeta = 1\nalpha = 2\nmiddle = 3\n\n[zulu]\nb = 1\na = 2\nnew_key = n\n\n[.yankee]\n"
+                            "key = y\n\n[alpha]\nkey = a\n\n");
+
+    // A reload keeps the order of the new text:
+    const std::string new_text = "alpha = 2\nzeta = 1\n\n[alpha]\nkey = a\n\n[zulu]\na = 2\nb = 1\n\n";
+    settings.reload_from_buffer(new_text);
+    stream.str("");
+    settings.write_to_stream(stream);
+    ASSERT_EQ(stream.str(), new_text);
+
+    // A move to a tree with another memory resource keeps the order:
+    std::pmr::monotonic_buffer_resource resource;
+    inis::section moved_settings(&resource);
+    moved_settings = std::move(settings);
+    stream.str("");
+    moved_settings.write_to_stream(stream);
+    ASSERT_EQ(stream.str(), new_text);
+}
+
+TEST(inis_tests, write_mode_test)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "arba_inis_write_mode_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::filesystem::path path = dir / "settings.inis";
+    auto file_text = [&path]
+    {
+        inis::mapped_file file(path);
+        return std::string(file.view());
+    };
+    const std::string text = "// comment\nname = first // name\ncount = 12\n\n[net]\nhost = localhost\nport=80\n"
+                             "text =|END\nline\nEND\n";
+    {
+        std::ofstream stream(path);
+        stream << text;
+    }
+
+    // atomic:
+    inis::section settings;
+    settings.read_from_file(path);
+    std::filesystem::permissions(path, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+    settings.write_to_file(path, "END", inis::section::write_mode::atomic);
+    std::ostringstream stream;
+    settings.write_to_stream(stream, "END");
+    ASSERT_EQ(file_text(), stream.str());
+    ASSERT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 1);
+    ASSERT_EQ(std::filesystem::status(path).permissions(),
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+
+    // patch:
+    {
+        std::ofstream stream(path);
+        stream << text;
+    }
+    inis::section patched_settings;
+    patched_settings.enable_source_spans();
+    patched_settings.read_from_file(path);
+    ASSERT_TRUE(patched_settings.set_setting("name", "other"));
+    patched_settings.write_to_file(path, "END", inis::section::write_mode::patch);
+    ASSERT_EQ(file_text(), "// comment\nname = other // name\ncount = 12\n\n[net]\nhost = localhost\nport=80\n"
+                           "text =|END\nline\nEND\n");
+    ASSERT_TRUE(patched_settings.set_setting("count", 7));
+    ASSERT_TRUE(patched_settings.set_setting("net.port", 8080));
+    patched_settings.write_to_file(path, "END", inis::section::write_mode::patch);
+    ASSERT_EQ(file_text(), "// comment\nname = other // name\ncount = 7\n\n[net]\nhost = localhost\nport=8080\n"
+                           "text =|END\nline\nEND\n");
+    ASSERT_TRUE(patched_settings.set_setting("net.host", "example.org"));
+    patched_settings.write_to_file(path, "END", inis::section::write_mode::patch);
+    ASSERT_EQ(file_text(), "// comment\nname = other // name\ncount = 7\n\n[net]\nhost = example.org\nport=8080\n"
+                           "text =|END\nline\nEND\n");
+    inis::section read_settings;
+    read_settings.read_from_file(path);
+    ASSERT_TRUE(patched_settings.changed_setting_paths(read_settings).empty());
+
+    // A value without position is modified: the file is entirely written.
+    ASSERT_TRUE(patched_settings.set_setting("net.text", "new\nlines"));
+    patched_settings.write_to_file(path, "END", inis::section::write_mode::patch);
+    stream.str("");
+    patched_settings.write_to_stream(stream, "END");
+    ASSERT_EQ(file_text(), stream.str());
+
+    // truncate: a mapped file is replaced, not truncated (an access beyond the new end would raise SIGBUS).
+    {
+        std::ofstream big_stream(path);
+        big_stream << "text = " << std::string(512 * 1024, 'x') << '\n';
+    }
+    {
+        inis::mapped_file big_file(path);
+        settings.write_to_file(path, "END");
+        ASSERT_EQ(big_file.view().substr(big_file.size() - 2), "x\n");
+    }
+    stream.str("");
+    settings.write_to_stream(stream, "END");
+    ASSERT_EQ(file_text(), stream.str());
+    ASSERT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 1);
+    // A symbolic link is written through:
+    const std::filesystem::path link_path = dir / "link.inis";
+    std::filesystem::create_symlink(path, link_path);
+    ASSERT_TRUE(settings.set_setting("count", 99));
+    settings.write_to_file(link_path, "END");
+    ASSERT_TRUE(std::filesystem::is_symlink(link_path));
+    inis::section linked_settings;
+    linked_settings.read_from_file(path);
+    ASSERT_EQ(linked_settings.setting<int>("count"), 99);
+    std::filesystem::remove_all(dir);
+}
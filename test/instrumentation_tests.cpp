@@ -0,0 +1,110 @@
+#include <arba/inis/inis.hpp>
+#include <arba/inis/instrumentation.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const char* const settings_text = R"inis(
+name = value
+long_value = a value which is too long for the small string buffer
+[section.subsection]
+number = 42
+path = {name}/{section.subsection.number}
+)inis";
+
+struct recorded_span
+{
+    std::string name;
+    std::chrono::nanoseconds duration;
+};
+
+void record_span(std::string_view name, std::chrono::steady_clock::time_point, std::chrono::nanoseconds duration,
+                 void* user_data)
+{
+    static_cast<std::vector<recorded_span>*>(user_data)->push_back(recorded_span{ std::string(name), duration });
+}
+
+} // namespace
+
+TEST(instrumentation_tests, statistics_test)
+{
+    inis::instrumentation::reset_statistics();
+    std::istringstream stream(settings_text);
+    inis::section settings;
+    settings.read_from_stream(stream);
+    ASSERT_EQ(settings.setting<int>("section.subsection.number"), 42);
+    ASSERT_EQ(settings.formatted_setting("section.subsection.path"), "value/42");
+    std::thread([] { inis::section().read_from_buffer("key = value\n"); }).join();
+
+    const inis::instrumentation::statistics stats = inis::instrumentation::current_statistics();
+    if constexpr (inis::instrumentation::enabled)
+    {
+        ASSERT_EQ(stats.parsed_lines, 7 + 2); // the lines after the last new lines are empty
+        ASSERT_EQ(stats.scanned_bytes, std::string_view(settings_text).size() + 12);
+        ASSERT_GE(stats.lookups, 1);
+        ASSERT_GE(stats.lookup_path_depth, 3);
+        ASSERT_EQ(stats.format_expansions, 3);
+        ASSERT_EQ(stats.max_format_depth, 2);
+        ASSERT_GT(stats.tree_allocations, 0);
+        ASSERT_GT(stats.allocations_per_operation(), 0.);
+    }
+    else
+    {
+        ASSERT_EQ(stats.parsed_lines, 0);
+        ASSERT_EQ(stats.lookups, 0);
+        ASSERT_EQ(stats.operations, 0);
+    }
+
+    inis::instrumentation::reset_statistics();
+    ASSERT_EQ(inis::instrumentation::current_statistics().parsed_lines, 0);
+}
+
+TEST(instrumentation_tests, span_hook_test)
+{
+    std::vector<recorded_span> spans;
+    inis::instrumentation::set_span_hook(&record_span, &spans);
+    {
+        inis::instrumentation::scoped_span span("custom");
+    }
+    inis::section settings;
+    settings.read_from_buffer(settings_text);
+    inis::instrumentation::set_span_hook(nullptr);
+    settings.read_from_buffer(settings_text);
+
+    ASSERT_FALSE(spans.empty());
+    ASSERT_EQ(spans.front().name, "custom");
+    ASSERT_GE(spans.front().duration.count(), 0);
+    if constexpr (inis::instrumentation::enabled)
+    {
+        ASSERT_EQ(spans.size(), 2);
+        ASSERT_EQ(spans.back().name, "inis.parse");
+    }
+    else
+        ASSERT_EQ(spans.size(), 1);
+}
+
+TEST(instrumentation_tests, memory_stats_test)
+{
+    inis::section settings;
+    settings.read_from_buffer(settings_text);
+    const inis::section::memory_statistics stats = settings.memory_stats();
+    ASSERT_EQ(stats.number_of_sections, 3);
+    // name, long_value, number, path, and the special settings ($working_dir, $tmp_dir)
+    ASSERT_EQ(stats.number_of_settings, 6);
+    ASSERT_GE(stats.value_bytes, std::string_view("a value which is too long for the small string buffer").size());
+    ASSERT_GT(stats.map_bytes, 0);
+    ASSERT_GE(stats.node_bytes, 3 * sizeof(inis::section));
+    ASSERT_EQ(stats.total_bytes(), stats.key_bytes + stats.value_bytes + stats.map_bytes + stats.node_bytes);
+
+    const inis::section::memory_statistics subsection_stats = settings.subsection("section").memory_stats();
+    ASSERT_EQ(subsection_stats.number_of_sections, 2);
+    ASSERT_EQ(subsection_stats.number_of_settings, 2);
+    ASSERT_LT(subsection_stats.total_bytes(), stats.total_bytes());
+}
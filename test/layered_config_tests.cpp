@@ -0,0 +1,108 @@
+#include <arba/inis/layered_config.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+
+inis::section make_section(std::string_view text)
+{
+    inis::section settings;
+    settings.read_from_buffer(text);
+    return settings;
+}
+
+inis::layered_config make_layered_config()
+{
+    inis::layered_config config;
+    config.push_layer(make_section(R"inis(
+name = defaults
+port = 80
+[log]
+level = info
+file = app.log
+)inis"));
+    config.push_layer(make_section(R"inis(
+name = site
+[log]
+level = warning
+)inis"));
+    config.push_layer(make_section(R"inis(
+[log]
+level = debug
+)inis"));
+    return config;
+}
+
+} // namespace
+
+TEST(layered_config_tests, setting_test)
+{
+    const inis::layered_config config = make_layered_config();
+    ASSERT_EQ(config.number_of_layers(), 3);
+    ASSERT_EQ(config.setting<std::string>("name"), "site");
+    ASSERT_EQ(config.layer_of("name"), 1);
+    ASSERT_EQ(config.setting<int>("port"), 80);
+    ASSERT_EQ(config.layer_of("port"), 0);
+    ASSERT_EQ(config.setting<std::string_view>("log.level"), "debug");
+    ASSERT_EQ(config.layer_of("log.level"), 2);
+    ASSERT_EQ(config.setting<std::string>("log.file"), "app.log");
+    ASSERT_FALSE(config.has_setting("log.missing"));
+    ASSERT_EQ(config.layer_of("log.missing"), inis::layered_config::npos);
+    ASSERT_EQ(config.setting<int>("log.missing", -1), -1);
+    ASSERT_EQ(config.setting<std::string>("log.missing", "default"), "default");
+}
+
+TEST(layered_config_tests, set_setting_test)
+{
+    inis::layered_config config = make_layered_config();
+    ASSERT_TRUE(config.set_setting(0, "log.level", "error"));
+    ASSERT_EQ(config.setting<std::string>("log.level"), "debug");
+    ASSERT_TRUE(config.set_setting(2, "port", 8080));
+    ASSERT_EQ(config.setting<int>("port"), 8080);
+    ASSERT_EQ(config.layer_of("port"), 2);
+    ASSERT_FALSE(config.set_setting(2, "missing_section.port", 8080));
+}
+
+TEST(layered_config_tests, reload_layer_test)
+{
+    inis::layered_config config = make_layered_config();
+    inis::section::change_set changes = config.reload_layer_from_buffer(1, R"inis(
+port = 81
+[log]
+file = site.log
+)inis");
+    ASSERT_EQ(changes.added, (std::vector<std::string>{ "log.file", "port" }));
+    ASSERT_EQ(changes.removed, (std::vector<std::string>{ "log.level", "name" }));
+    // Removed from the site layer: provided by the defaults layer again.
+    ASSERT_EQ(config.setting<std::string>("name"), "defaults");
+    ASSERT_EQ(config.layer_of("name"), 0);
+    ASSERT_EQ(config.setting<int>("port"), 81);
+    ASSERT_EQ(config.setting<std::string>("log.file"), "site.log");
+    ASSERT_EQ(config.setting<std::string>("log.level"), "debug");
+
+    changes = config.reload_layer_from_buffer(2, "");
+    ASSERT_EQ(config.setting<std::string>("log.level"), "info");
+    ASSERT_EQ(config.layer_of("log.level"), 0);
+}
+
+TEST(layered_config_tests, replace_layer_test)
+{
+    inis::layered_config config = make_layered_config();
+    std::vector<std::string> changed_paths = config.replace_layer(1, make_section(R"inis(
+name = new_site
+[log]
+file = site.log
+)inis"));
+    ASSERT_EQ(changed_paths, (std::vector<std::string>{ "log.file", "log.level", "name" }));
+    ASSERT_EQ(config.setting<std::string>("name"), "new_site");
+    ASSERT_EQ(config.setting<std::string>("log.file"), "site.log");
+    ASSERT_EQ(config.setting<std::string>("log.level"), "debug");
+
+    config.replace_layer(2, make_section("port = 443\n"));
+    ASSERT_EQ(config.setting<std::string>("log.level"), "info");
+    ASSERT_EQ(config.setting<int>("port"), 443);
+    ASSERT_EQ(config.setting<std::string>("name"), "new_site");
+}
@@ -0,0 +1,73 @@
+#include <arba/inis/line_scanner.hpp>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::vector<inis::line_delimiters> scan_naively(std::string_view buffer, std::string_view comment_marker)
+{
+    std::vector<inis::line_delimiters> lines;
+    for (;;)
+    {
+        std::size_t line_end = buffer.find('\n');
+        inis::line_delimiters delimiters;
+        delimiters.line = buffer.substr(0, line_end);
+        delimiters.equal = delimiters.line.find('=');
+        delimiters.comment = delimiters.line.find(comment_marker);
+        lines.push_back(delimiters);
+        if (line_end == std::string_view::npos)
+            break;
+        buffer.remove_prefix(line_end + 1);
+    }
+    return lines;
+}
+
+std::string random_text(std::size_t size, unsigned seed)
+{
+    static constexpr std::string_view alphabet = "ab =//[]\n\n.";
+    std::mt19937 engine(seed);
+    std::uniform_int_distribution<std::size_t> distribution(0, alphabet.size() - 1);
+    std::string text;
+    for (std::size_t i = 0; i < size; ++i)
+        text += alphabet[distribution(engine)];
+    return text;
+}
+
+} // namespace
+
+TEST(line_scanner_tests, scan_test)
+{
+    std::vector<std::string> texts = { "", "\n", "a", "a = b // c", "a = b\n", "[section]\nkey = value // x\n\n",
+                                       std::string(63, 'a') + "\n=", std::string(64, '=') + "//",
+                                       std::string(63, ' ') + "//" + std::string(70, '\n') };
+    for (unsigned seed = 0; seed < 32; ++seed)
+        texts.push_back(random_text(seed * 17, seed));
+
+    for (inis::scan_kernel kernel :
+         { inis::scan_kernel::automatic, inis::scan_kernel::scalar, inis::scan_kernel::sse2, inis::scan_kernel::avx2 })
+    {
+        if (!inis::line_scanner::is_supported(kernel))
+            continue;
+        for (const std::string& text : texts)
+        {
+            std::vector<inis::line_delimiters> expected_lines = scan_naively(text, "//");
+            inis::line_scanner scanner(text, "//", kernel);
+            inis::line_delimiters delimiters;
+            std::size_t index = 0;
+            for (; scanner.next(delimiters); ++index)
+            {
+                ASSERT_LT(index, expected_lines.size());
+                ASSERT_EQ(delimiters.line.data(), expected_lines[index].line.data());
+                ASSERT_EQ(delimiters.line, expected_lines[index].line);
+                ASSERT_EQ(delimiters.equal, expected_lines[index].equal);
+                ASSERT_EQ(delimiters.comment, expected_lines[index].comment);
+            }
+            ASSERT_EQ(index, expected_lines.size());
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <arba/inis/inis.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+namespace
+{
+
+std::size_t allocation_count = 0;
+
+// All the replaced allocation functions use this pair: once they are inlined, GCC sees std::free() release a pointer
+// returned by operator new (-Wmismatched-new-delete).
+[[gnu::noinline]] void* counted_allocate(std::size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void counted_deallocate(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    counted_deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    counted_deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    counted_deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    counted_deallocate(ptr);
+}
+
+namespace
+{
+
+inis::section make_settings()
+{
+    std::istringstream stream(R"inis(
+global_setting_with_a_long_name = global value
+[section_with_a_long_name]
+[.subsection_with_a_long_name]
+setting_with_a_long_name = 42
+double_setting_with_a_long_name = 42.5
+bool_setting_with_a_long_name = true
+)inis");
+    inis::section settings;
+    settings.read_from_stream(stream);
+    return settings;
+}
+
+} // namespace
+
+TEST(lookup_allocation_tests, lookup_does_not_allocate_test)
+{
+    inis::section settings = make_settings();
+    const inis::section& csettings = settings;
+    const std::string default_value = "default value which does not fit in a small string";
+
+    std::size_t initial_allocation_count = allocation_count;
+    const inis::section* subsection =
+        csettings.subsection_ptr("section_with_a_long_name.subsection_with_a_long_name");
+    std::string_view value = csettings.setting<std::string_view>(
+        "section_with_a_long_name.subsection_with_a_long_name.setting_with_a_long_name");
+    std::string_view global_value = csettings.setting<std::string_view>("global_setting_with_a_long_name");
+    std::string_view missing_value =
+        csettings.setting<std::string_view>("section_with_a_long_name.missing_subsection.missing_setting");
+    const std::string& default_ref =
+        csettings.setting<std::string>("section_with_a_long_name.missing_setting", default_value);
+    int int_value =
+        csettings.setting<int>("section_with_a_long_name.subsection_with_a_long_name.setting_with_a_long_name");
+    double double_value = csettings.setting<double>(
+        "section_with_a_long_name.subsection_with_a_long_name.double_setting_with_a_long_name");
+    bool bool_value = csettings.setting<bool>(
+        "section_with_a_long_name.subsection_with_a_long_name.bool_setting_with_a_long_name");
+    ASSERT_EQ(allocation_count, initial_allocation_count);
+
+    ASSERT_NE(subsection, nullptr);
+    ASSERT_EQ(value, "42");
+    ASSERT_EQ(global_value, "global value");
+    ASSERT_EQ(missing_value, "");
+    ASSERT_EQ(&default_ref, &default_value);
+    ASSERT_EQ(int_value, 42);
+    ASSERT_DOUBLE_EQ(double_value, 42.5);
+    ASSERT_TRUE(bool_value);
+}